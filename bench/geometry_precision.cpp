@@ -0,0 +1,190 @@
+// Renders the bundled scenes with the geometry precision of this build and
+// prints the time of each camera configuration and the size of the types
+// that traversal reads. Built twice, as geometry_precision (double) and
+// geometry_precision_float (RAYTRACER_SINGLE_PRECISION); run both to compare
+// the modes:
+//
+//   geometry_precision [default|sonic] [image width] [repeats]
+//
+// Each run saves its frames as geometry_precision_<scene>_<mode>.bin in the
+// working directory and, if the other mode's frames of the same scene and
+// size are there, reports how many pixels differ from them. Built with
+// -DRAYTRACER_BUILD_BENCHMARKS=ON; run it from the build directory so the
+// Sonic scene finds its assets.
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <stb_image.h>
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "raytracer.h"
+#include "camera.h"
+#include "sphere.h"
+#include "plane.h"
+#include "cylinder.h"
+#include "cone.h"
+#include "box.h"
+#include "torus.h"
+#include "squarepyramid.h"
+#include "scene_builder.h"
+
+namespace {
+
+struct Configuration {
+    const char* name;
+    bool shadows;
+    bool orthographic;
+};
+
+const Configuration configurations[] = {
+    { "perspective",               true,  false },
+    { "perspective, no shadows",   false, false },
+    { "orthographic",              true,  true  },
+    { "orthographic, no shadows",  false, true  },
+};
+
+const char* mode_name(bool single) {
+    return single ? "float" : "double";
+}
+
+// Same objects and lights as the scene main() opens with, with a procedural
+// texture in place of the brick image.
+void build_default_scene(SceneManager& world, checker_texture& checker, checker_texture& floor) {
+    world.add(std::make_shared<plane>(point3(0, -0.5, 0), vec3(0, 1, 0), mat(&floor, 0.8, 1.0, 100.0, 0.25)));
+    world.add(std::make_shared<sphere>(point3(0, 0, -1), 0.45, mat(&checker)));
+    world.add(std::make_shared<cylinder>(point3(-1.0, -0.25, -1), point3(-1.0, 0.35, -1), 0.3, mat(color(0, 0, 1))));
+    world.add(std::make_shared<cone>(point3(1, -0.15, -1), point3(1, 0.5, -1.5), 0.3, mat(color(1, 0, 0))));
+    world.add(std::make_shared<torus>(point3(-2, 0, -1), 0.3, 0.1, vec3(0, 0.5, 0.5), mat(color(0, 1, 0.9))));
+    world.add(std::make_shared<SquarePyramid>(point3(1.8, -0.3, -1), 0.8, 0.5, mat(color(0, 1, 0))));
+    world.add(std::make_shared<box>(point3(2.6, 0, -1), 0.7, mat(color(0.7, 0.3, 0.2))));
+    world.add_directional_light(vec3(-0.6, -0.38, -0.7), 0.85, color(1, 1, 1));
+    world.add_point_light(vec3(-1, 0, 0.5), 1.0, color(0, 0.45, 0.64));
+}
+
+// Best time of 'repeats' renders, after one warm-up render.
+double time_render(const Camera& camera, const SceneManager& world, FrameBuffer& frame, int repeats) {
+    TileScheduler scheduler;
+    camera.render(world, frame, 1, false, nullptr, nullptr, nullptr, &scheduler);
+
+    double best = infinity;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        camera.render(world, frame, 1, false, nullptr, nullptr, nullptr, &scheduler);
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+std::string frames_path(const std::string& scene, bool single) {
+    return "geometry_precision_" + scene + "_" + mode_name(single) + ".bin";
+}
+
+// All configurations' pixels, after the image size
+void save_frames(const std::string& path, int width, int height, const std::vector<Uint32>& pixels) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&width), sizeof(width));
+    out.write(reinterpret_cast<const char*>(&height), sizeof(height));
+    out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size() * sizeof(Uint32));
+}
+
+bool load_frames(const std::string& path, int width, int height, size_t count, std::vector<Uint32>& pixels) {
+    std::ifstream in(path, std::ios::binary);
+    int saved_width = 0, saved_height = 0;
+    in.read(reinterpret_cast<char*>(&saved_width), sizeof(saved_width));
+    in.read(reinterpret_cast<char*>(&saved_height), sizeof(saved_height));
+    if (!in || saved_width != width || saved_height != height) {
+        return false;
+    }
+    pixels.resize(count);
+    in.read(reinterpret_cast<char*>(pixels.data()), count * sizeof(Uint32));
+    return static_cast<bool>(in);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const std::string scene = argc > 1 ? argv[1] : "default";
+    const int image_width = argc > 2 ? std::atoi(argv[2]) : 720;
+    const int repeats = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 3;
+    const bool single = std::is_same<real, float>::value;
+
+    checker_texture checker(color(0, 0, 0), color(1, 1, 1), 15);
+    checker_texture floor(color(0, 0, 0), color(1, 1, 1), 2);
+    SceneBuilder builder;
+    SceneManager world;
+    point3 origin(-2.0, 0.7, 3.0);
+    point3 look_at(0.5, 0.15, -0.5);
+    if (scene == "sonic") {
+        builder.buildSonicScene(world);
+        world.add_directional_light(vec3(-0.6, -0.38, -0.7), 0.85, color(1, 1, 1));
+        world.add_point_light(point3(6.2, 0.15, 0.5), 1.3, color(1, 0.87, 0.12));
+        origin = point3(-1.4, 3.4, 16.2);
+        look_at = point3(-1.2, 7.7, -3);
+    }
+    else if (scene == "default") {
+        build_default_scene(world, checker, floor);
+    }
+    else {
+        std::cerr << "Unknown scene '" << scene << "'; expected 'default' or 'sonic'.\n";
+        return 1;
+    }
+    world.buildBVH(false);
+
+    Camera base(origin, look_at, image_width, 16.0 / 9.0, 60);
+    base.set_BGtop(color(0.3, 0.58, 1));
+
+    std::cout << "Scene '" << scene << "', " << base.get_image_width() << "x" << base.get_image_height()
+        << ", " << mode_name(single) << " geometry, best of " << repeats << "\n"
+        << "bytes: vec3 " << sizeof(vec3) << ", ray " << sizeof(ray) << ", BoundingBox " << sizeof(BoundingBox)
+        << ", triangle " << sizeof(triangle) << ", BVHNode " << sizeof(BVHNode)
+        << ", hit_record " << sizeof(hit_record) << "\n\n";
+
+    std::vector<Uint32> pixels;
+    std::vector<double> times;
+    for (const Configuration& config : configurations) {
+        Camera camera = base;
+        if (!config.shadows) {
+            camera.toggleShadows();
+        }
+        if (config.orthographic) {
+            camera.use_orthographic_projection();
+            camera.set_ortho_scale(2.0);
+        }
+        FrameBuffer frame;
+        times.push_back(time_render(camera, world, frame, repeats));
+        pixels.insert(pixels.end(), frame.pixels.begin(), frame.pixels.end());
+    }
+    save_frames(frames_path(scene, single), base.get_image_width(), base.get_image_height(), pixels);
+
+    std::vector<Uint32> other;
+    const bool compare = load_frames(frames_path(scene, !single), base.get_image_width(), base.get_image_height(), pixels.size(), other);
+    const size_t frame_size = pixels.size() / std::size(configurations);
+
+    std::cout << std::left << std::setw(28) << "configuration" << std::right << std::setw(10) << "ms";
+    if (compare) {
+        std::cout << "  pixels differing from " << mode_name(!single);
+    }
+    std::cout << "\n";
+    for (size_t c = 0; c < std::size(configurations); ++c) {
+        std::cout << std::left << std::setw(28) << configurations[c].name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(10) << times[c];
+        if (compare) {
+            size_t differing = 0;
+            for (size_t i = c * frame_size; i < (c + 1) * frame_size; ++i) {
+                differing += pixels[i] != other[i];
+            }
+            std::cout << "  " << differing << " (" << std::setprecision(3) << 100.0 * differing / frame_size << "%)";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+// Compares a generic tile loop with Camera's compile-time specialized tile
+// kernels on every camera configuration and prints the time of each and the
+// speedup.
+//
+//   render_kernels [default|sonic] [image width] [repeats]
+//
+// Built with -DRAYTRACER_BUILD_BENCHMARKS=ON; run it from the build directory
+// so the Sonic scene finds its assets.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stb_image.h>
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "raytracer.h"
+#include "camera.h"
+#include "sphere.h"
+#include "plane.h"
+#include "cylinder.h"
+#include "cone.h"
+#include "box.h"
+#include "torus.h"
+#include "squarepyramid.h"
+#include "scene_builder.h"
+#include "tile_frustum.h"
+
+namespace {
+
+struct Configuration {
+    const char* name;
+    bool shadows;
+    bool orthographic;
+    bool camera_space;
+    bool antialias;
+};
+
+const Configuration configurations[] = {
+    { "perspective",               true,  false, false, false },
+    { "perspective, no shadows",   false, false, false, false },
+    { "orthographic",              true,  true,  false, false },
+    { "orthographic, no shadows",  false, true,  false, false },
+    { "camera space",              true,  false, true,  false },
+    { "perspective, antialiased",  true,  false, false, true  },
+};
+
+constexpr int antialias_samples = 4;
+
+// Same objects and lights as the scene main() opens with, with a procedural
+// texture in place of the brick image.
+void build_default_scene(SceneManager& world, checker_texture& checker, checker_texture& floor) {
+    world.add(std::make_shared<plane>(point3(0, -0.5, 0), vec3(0, 1, 0), mat(&floor, 0.8, 1.0, 100.0, 0.25)));
+    world.add(std::make_shared<sphere>(point3(0, 0, -1), 0.45, mat(&checker)));
+    world.add(std::make_shared<cylinder>(point3(-1.0, -0.25, -1), point3(-1.0, 0.35, -1), 0.3, mat(color(0, 0, 1))));
+    world.add(std::make_shared<cone>(point3(1, -0.15, -1), point3(1, 0.5, -1.5), 0.3, mat(color(1, 0, 0))));
+    world.add(std::make_shared<torus>(point3(-2, 0, -1), 0.3, 0.1, vec3(0, 0.5, 0.5), mat(color(0, 1, 0.9))));
+    world.add(std::make_shared<SquarePyramid>(point3(1.8, -0.3, -1), 0.8, 0.5, mat(color(0, 1, 0))));
+    world.add(std::make_shared<box>(point3(2.6, 0, -1), 0.7, mat(color(0.7, 0.3, 0.2))));
+    world.add_directional_light(vec3(-0.6, -0.38, -0.7), 0.85, color(1, 1, 1));
+    world.add_point_light(vec3(-1, 0, 0.5), 1.0, color(0, 0.45, 0.64));
+}
+
+// The tile loop before specialization, built from Camera's public interface:
+// the projection goes through a member function pointer and shadows and
+// antialiasing are tested for every sample. The primary hits come from the
+// BVH subtrees each tile's frustum reaches, as in Camera's kernels, so only
+// the specialization differs.
+void render_generic(const Camera& camera, const SceneManager& world, FrameBuffer& frame, int samples_per_pixel,
+    bool antialias, TileScheduler& scheduler)
+{
+    const int image_width = camera.get_image_width();
+    const int image_height = camera.get_image_height();
+    frame.resize(image_width, image_height);
+    Uint32* pixels = frame.data();
+    const std::shared_ptr<BVHNode> bvh = world.getBVH();
+
+    scheduler.run(image_width, image_height, camera.get_tile_size(), [&](const Tile& tile) {
+        const ray corners[4] = {
+            camera.primary_ray(tile.x0, tile.y0, 0.0, 0.0),
+            camera.primary_ray(tile.x1 - 1, tile.y0, 1.0, 0.0),
+            camera.primary_ray(tile.x1 - 1, tile.y1 - 1, 1.0, 1.0),
+            camera.primary_ray(tile.x0, tile.y1 - 1, 0.0, 1.0)
+        };
+        const TileFrustum frustum(corners);
+        std::vector<const BVHNode*> subtrees;
+        bvh->collect_subtrees([&](const BoundingBox& box) { return frustum.excludes(box); },
+            CameraRays, Camera::max_tile_subtrees, subtrees);
+        std::sort(subtrees.begin(), subtrees.end(), [&](const BVHNode* a, const BVHNode* b) {
+            return frustum.depth(a->bounding_box()) < frustum.depth(b->bounding_box());
+        });
+
+        for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+            for (int pixel_x = tile.x0; pixel_x < tile.x1; ++pixel_x) {
+                color accumulated_color(0, 0, 0);
+                int spp = antialias ? samples_per_pixel : 1;
+                for (int s = 0; s < spp; s++) {
+                    double offset_x = antialias ? random_double(0.0, 1.0) : 0.5;
+                    double offset_y = antialias ? random_double(0.0, 1.0) : 0.5;
+                    ray r = camera.primary_ray(pixel_x, pixel_y, offset_x, offset_y);
+
+                    hit_record rec;
+                    bool hit = false;
+                    double closest_so_far = infinity;
+                    for (const BVHNode* subtree : subtrees) {
+                        if (subtree->hit_closest(r, interval(0.001, closest_so_far), rec)) {
+                            hit = true;
+                            closest_so_far = rec.t;
+                        }
+                    }
+                    if (hit) {
+                        complete_pending_hit(r, rec);
+                    }
+                    accumulated_color += camera.shade_primary(world, r, hit ? &rec : nullptr);
+                }
+                accumulated_color *= (1.0 / spp);
+                write_color(pixels, pixel_x, image_height - 1 - pixel_y, image_width, image_height, accumulated_color);
+            }
+        }
+    });
+}
+
+// Best time of 'repeats' renders, after one warm-up render.
+template <typename Render>
+double time_render(Render&& render, int repeats) {
+    render();
+
+    double best = infinity;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        render();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const std::string scene = argc > 1 ? argv[1] : "default";
+    const int image_width = argc > 2 ? std::atoi(argv[2]) : 720;
+    const int repeats = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 3;
+
+    checker_texture checker(color(0, 0, 0), color(1, 1, 1), 15);
+    checker_texture floor(color(0, 0, 0), color(1, 1, 1), 2);
+    SceneBuilder builder;
+    SceneManager world;
+    point3 origin(-2.0, 0.7, 3.0);
+    point3 look_at(0.5, 0.15, -0.5);
+    if (scene == "sonic") {
+        builder.buildSonicScene(world);
+        world.add_directional_light(vec3(-0.6, -0.38, -0.7), 0.85, color(1, 1, 1));
+        world.add_point_light(point3(6.2, 0.15, 0.5), 1.3, color(1, 0.87, 0.12));
+        origin = point3(-1.4, 3.4, 16.2);
+        look_at = point3(-1.2, 7.7, -3);
+    }
+    else if (scene == "default") {
+        build_default_scene(world, checker, floor);
+    }
+    else {
+        std::cerr << "Unknown scene '" << scene << "'; expected 'default' or 'sonic'.\n";
+        return 1;
+    }
+    world.buildBVH(false);
+
+    Camera base(origin, look_at, image_width, 16.0 / 9.0, 60);
+    base.set_BGtop(color(0.3, 0.58, 1));
+
+    // Camera-space rendering expects the scene already moved into view space
+    std::unique_ptr<SceneManager> camera_space_world = world.snapshot();
+    camera_space_world->transform(base.world_to_camera_matrix);
+    camera_space_world->buildBVH(false);
+
+    std::cout << "Scene '" << scene << "', " << base.get_image_width() << "x" << base.get_image_height()
+        << ", best of " << repeats << "\n\n";
+    std::cout << std::left << std::setw(28) << "configuration"
+        << std::right << std::setw(14) << "generic ms" << std::setw(16) << "specialized ms"
+        << std::setw(10) << "speedup" << "  image\n";
+
+    for (const Configuration& config : configurations) {
+        Camera camera = base;
+        if (!config.shadows) {
+            camera.toggleShadows();
+        }
+        if (config.orthographic) {
+            camera.use_orthographic_projection();
+            camera.set_ortho_scale(2.0);
+        }
+        if (config.camera_space) {
+            camera.toggleCameraSpace();
+        }
+        const SceneManager& target = config.camera_space ? *camera_space_world : world;
+
+        TileScheduler scheduler;
+        const int samples = config.antialias ? antialias_samples : 1;
+        FrameBuffer generic_frame, specialized_frame;
+        double generic_ms = time_render([&] {
+            render_generic(camera, target, generic_frame, samples, config.antialias, scheduler);
+        }, repeats);
+        double specialized_ms = time_render([&] {
+            camera.render(target, specialized_frame, samples, config.antialias, nullptr, nullptr, nullptr, &scheduler);
+        }, repeats);
+
+        // Jittered samples differ between runs, so only the others compare
+        const char* image = config.antialias ? "jittered"
+            : generic_frame.pixels == specialized_frame.pixels ? "identical" : "DIFFERS";
+        std::cout << std::left << std::setw(28) << config.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << generic_ms << std::setw(16) << specialized_ms
+            << std::setprecision(2) << std::setw(9) << generic_ms / specialized_ms << "x  " << image << "\n";
+    }
+    return 0;
+}
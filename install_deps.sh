@@ -13,7 +13,6 @@ sudo apt install -y \
     g++ \
     libsdl2-dev \
     libsdl2-ttf-dev \
-    libomp-dev \
     git
 
 echo "✅ Dependencies installed!"
\ No newline at end of file
@@ -181,9 +181,9 @@ public:
         interval temp_t = ray_t;
 
         for (int i = 0; i < 3; i++) {
-            double invD = 1.0 / r.direction()[i];
-            double t0 = (vmin[i] - r.origin()[i]) * invD;
-            double t1 = (vmax[i] - r.origin()[i]) * invD;
+            real invD = 1.0 / r.direction()[i];
+            real t0 = (vmin[i] - r.origin()[i]) * invD;
+            real t1 = (vmax[i] - r.origin()[i]) * invD;
 
             if (invD < 0.0) {
                 std::swap(t0, t1);
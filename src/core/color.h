@@ -26,7 +26,7 @@ inline void write_color(Uint32* pixels, int x, int y, int image_width, int image
     pixels[(image_height - 1 - y) * image_width + x] = (rbyte << 16) | (gbyte << 8) | bbyte;
 }
 
-inline color clamp(const color& c, double minVal, double maxVal) {
+inline color clamp(const color& c, real minVal, real maxVal) {
     return color(
         std::max(minVal, std::min(c.x(), maxVal)),
         std::max(minVal, std::min(c.y(), maxVal)),
@@ -13,14 +13,22 @@ class hit_record {
 public:
     point3 p = point3(0, 0, 0);
     vec3 normal = vec3(0, 0, 0);
-    double t = 0.0;
+    real t = 0.0;
     bool front_face = true;
     const mat* material = nullptr;
-    double u = 0.0;
-    double v = 0.0;
+    real u = 0.0;
+    real v = 0.0;
 
     const hittable* hit_object = nullptr;
 
+    // Primitive that still has to fill in p, normal, material and UV, left by
+    // hittable::hit_closest(); until then u and v hold its own parameters.
+    const hittable* pending = nullptr;
+
+    // When 'pending' is an object that intersects its parts in its own space
+    // (see ObjectTransform), the part that was hit, which fills in the record
+    // in that space before 'pending' maps it to the world.
+    const hittable* pending_part = nullptr;
 
     hit_record() = default;
 
@@ -32,6 +40,8 @@ public:
         material = nullptr;
         u = v = 0.0;
         hit_object = nullptr;
+        pending = nullptr;
+        pending_part = nullptr;
     }
 
     inline void set_face_normal(const ray& r, const vec3& outward_normal) {
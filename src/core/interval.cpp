@@ -1,6 +1,6 @@
 #include "interval.h"
 
-const interval interval::empty = interval(+std::numeric_limits<double>::infinity(),
-    -std::numeric_limits<double>::infinity());
-const interval interval::universe = interval(-std::numeric_limits<double>::infinity(),
-    +std::numeric_limits<double>::infinity());
\ No newline at end of file
+const interval interval::empty = interval(+std::numeric_limits<real>::infinity(),
+    -std::numeric_limits<real>::infinity());
+const interval interval::universe = interval(-std::numeric_limits<real>::infinity(),
+    +std::numeric_limits<real>::infinity());
\ No newline at end of file
@@ -2,57 +2,59 @@
 #define INTERVAL_H
 #include <limits>
 
+#include "real.h"
+
 class interval {
 public:
-    double min, max;
+    real min, max;
 
     // Default constructor - creates empty interval
-    interval() : min(+std::numeric_limits<double>::infinity()),
-        max(-std::numeric_limits<double>::infinity()) {
+    interval() : min(+std::numeric_limits<real>::infinity()),
+        max(-std::numeric_limits<real>::infinity()) {
     }
 
     // Constructor with min and max
-    interval(double _min, double _max) : min(_min), max(_max) {}
+    interval(real _min, real _max) : min(_min), max(_max) {}
 
     // Returns interval size
-    double size() const {
+    real size() const {
         return max - min;
     }
 
     // Check if x is within the interval
-    bool contains(double x) const {
+    bool contains(real x) const {
         return min <= x && x <= max;
     }
 
     // Check if x is within the interval with bias
-    bool contains(double x, double bias) const {
+    bool contains(real x, real bias) const {
         return (min - bias) <= x && x <= (max + bias);
     }
 
     // Check if x is strictly within the interval
-    bool surrounds(double x) const {
+    bool surrounds(real x) const {
         return min < x && x < max;
     }
 
     // Check if x is strictly within the interval with bias
-    bool surrounds(double x, double bias) const {
+    bool surrounds(real x, real bias) const {
         return (min - bias) < x && x < (max + bias);
     }
 
     // Clamp a value to the interval
-    double clamp(double x) const {
+    real clamp(real x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
     }
 
     // Create a new interval with bias
-    interval with_bias(double bias) const {
+    interval with_bias(real bias) const {
         return interval(min - bias, max + bias);
     }
 
     // Expand the interval by a bias amount
-    void expand(double bias) {
+    void expand(real bias) {
         min -= bias;
         max += bias;
     }
@@ -6,12 +6,15 @@
 #include <iomanip> 
 #include <cstring>
 
+#include "simd.h"
 #include "vec4.h"
 #include "raytracer.h"
 
+// Row-major 4x4 matrix. Each row is one double4, so products and the inverse
+// work a row at a time on SIMD lanes (see simd.h).
 class Matrix4x4 {
 public:
-    double m[4][4];
+    alignas(32) double m[4][4];
 
     // Constructor: Identity matrix by default
     Matrix4x4() { set_identity(); }
@@ -70,23 +73,22 @@ public:
             std::cout << "\n";
         }
     }
-    // Matrix-matrix multiplication
+    double4 row(int i) const {
+        return double4::load(m[i]);
+    }
+
+    // Matrix-matrix multiplication: row i of the result is the rows of
+    // 'other' weighted by row i of this matrix
     Matrix4x4 operator*(const Matrix4x4& other) const {
         Matrix4x4 result;
-
-        // Initialize result matrix more effiently
-        std::memset(result.m, 0, sizeof(result.m));
-
+        double4 b0 = other.row(0), b1 = other.row(1), b2 = other.row(2), b3 = other.row(3);
         for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                result.m[i][j] =
-                    m[i][0] * other.m[0][j] +
-                    m[i][1] * other.m[1][j] +
-                    m[i][2] * other.m[2][j] +
-                    m[i][3] * other.m[3][j];
-            }
+            double4 r = b0 * double4::broadcast(m[i][0]);
+            r = multiply_add(b1, double4::broadcast(m[i][1]), r);
+            r = multiply_add(b2, double4::broadcast(m[i][2]), r);
+            r = multiply_add(b3, double4::broadcast(m[i][3]), r);
+            r.store(result.m[i]);
         }
-
         return result;
     }
 
@@ -361,82 +363,62 @@ public:
 
     Matrix4x4 inverse() const {
         constexpr double SINGULARITY_TOLERANCE = 1e-10;
-        Matrix4x4 inv;
-        double det;
-
-        // Helper lambda to calculate the determinant of a 3x3 matrix
-        auto det3x3 = [](double a11, double a12, double a13,
-            double a21, double a22, double a23,
-            double a31, double a32, double a33) -> double {
-                return a11 * (a22 * a33 - a23 * a32)
-                    - a12 * (a21 * a33 - a23 * a31)
-                    + a13 * (a21 * a32 - a22 * a31);
-            };
-
-        // Calculate cofactors and transpose (adjoint) simultaneously
-        inv.m[0][0] = det3x3(m[1][1], m[1][2], m[1][3], m[2][1], m[2][2], m[2][3], m[3][1], m[3][2], m[3][3]);
-        inv.m[0][1] = -det3x3(m[0][1], m[0][2], m[0][3], m[2][1], m[2][2], m[2][3], m[3][1], m[3][2], m[3][3]);
-        inv.m[0][2] = det3x3(m[0][1], m[0][2], m[0][3], m[1][1], m[1][2], m[1][3], m[3][1], m[3][2], m[3][3]);
-        inv.m[0][3] = -det3x3(m[0][1], m[0][2], m[0][3], m[1][1], m[1][2], m[1][3], m[2][1], m[2][2], m[2][3]);
-
-        inv.m[1][0] = -det3x3(m[1][0], m[1][2], m[1][3], m[2][0], m[2][2], m[2][3], m[3][0], m[3][2], m[3][3]);
-        inv.m[1][1] = det3x3(m[0][0], m[0][2], m[0][3], m[2][0], m[2][2], m[2][3], m[3][0], m[3][2], m[3][3]);
-        inv.m[1][2] = -det3x3(m[0][0], m[0][2], m[0][3], m[1][0], m[1][2], m[1][3], m[3][0], m[3][2], m[3][3]);
-        inv.m[1][3] = det3x3(m[0][0], m[0][2], m[0][3], m[1][0], m[1][2], m[1][3], m[2][0], m[2][2], m[2][3]);
-
-        inv.m[2][0] = det3x3(m[1][0], m[1][1], m[1][3], m[2][0], m[2][1], m[2][3], m[3][0], m[3][1], m[3][3]);
-        inv.m[2][1] = -det3x3(m[0][0], m[0][1], m[0][3], m[2][0], m[2][1], m[2][3], m[3][0], m[3][1], m[3][3]);
-        inv.m[2][2] = det3x3(m[0][0], m[0][1], m[0][3], m[1][0], m[1][1], m[1][3], m[3][0], m[3][1], m[3][3]);
-        inv.m[2][3] = -det3x3(m[0][0], m[0][1], m[0][3], m[1][0], m[1][1], m[1][3], m[2][0], m[2][1], m[2][3]);
-
-        inv.m[3][0] = -det3x3(m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2], m[3][0], m[3][1], m[3][2]);
-        inv.m[3][1] = det3x3(m[0][0], m[0][1], m[0][2], m[2][0], m[2][1], m[2][2], m[3][0], m[3][1], m[3][2]);
-        inv.m[3][2] = -det3x3(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[3][0], m[3][1], m[3][2]);
-        inv.m[3][3] = det3x3(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2]);
-
-        // Compute the determinant
-        det = m[0][0] * inv.m[0][0] + m[0][1] * inv.m[0][1] + m[0][2] * inv.m[0][2] + m[0][3] * inv.m[0][3];
+        const Minors k = minors();
+        const double det = k.determinant();
 
         if (std::fabs(det) < SINGULARITY_TOLERANCE) {
             throw std::runtime_error("Matrix is singular and cannot be inverted.");
         }
 
-        // Normalize the inverse by the determinant
-        det = 1.0 / det;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                inv.m[i][j] *= det;
-            }
-        }
+        // Rows of the adjugate, each a sum of three lane-wise products of a
+        // signed column of this matrix with 2x2 minors of the other rows
+        const double4 a0(m[1][0], -m[0][0], m[3][0], -m[2][0]);
+        const double4 a1(m[1][1], -m[0][1], m[3][1], -m[2][1]);
+        const double4 a2(m[1][2], -m[0][2], m[3][2], -m[2][2]);
+        const double4 a3(m[1][3], -m[0][3], m[3][3], -m[2][3]);
+        auto pair = [&k](int i) { return double4(k.c[i], k.c[i], k.s[i], k.s[i]); };
 
+        const double4 scale = double4::broadcast(1.0 / det);
+        Matrix4x4 inv;
+        ((a1 * pair(5) - a2 * pair(4) + a3 * pair(3)) * scale).store(inv.m[0]);
+        ((a2 * pair(2) - a0 * pair(5) - a3 * pair(1)) * scale).store(inv.m[1]);
+        ((a0 * pair(4) - a1 * pair(2) + a3 * pair(0)) * scale).store(inv.m[2]);
+        ((a1 * pair(1) - a0 * pair(3) - a2 * pair(0)) * scale).store(inv.m[3]);
         return inv;
     }
 
     double determinant() const {
-        // Helper lambda to calculate the determinant of a 3x3 matrix
-        auto det3x3 = [](double a11, double a12, double a13,
-            double a21, double a22, double a23,
-            double a31, double a32, double a33) -> double {
-                return a11 * (a22 * a33 - a23 * a32)
-                    - a12 * (a21 * a33 - a23 * a31)
-                    + a13 * (a21 * a32 - a22 * a31);
-            };
-
-        // Expand along the first row
-        return m[0][0] * det3x3(m[1][1], m[1][2], m[1][3],
-            m[2][1], m[2][2], m[2][3],
-            m[3][1], m[3][2], m[3][3])
-            - m[0][1] * det3x3(m[1][0], m[1][2], m[1][3],
-                m[2][0], m[2][2], m[2][3],
-                m[3][0], m[3][2], m[3][3])
-            + m[0][2] * det3x3(m[1][0], m[1][1], m[1][3],
-                m[2][0], m[2][1], m[2][3],
-                m[3][0], m[3][1], m[3][3])
-            - m[0][3] * det3x3(m[1][0], m[1][1], m[1][2],
-                m[2][0], m[2][1], m[2][2],
-                m[3][0], m[3][1], m[3][2]);
+        return minors().determinant();
     }
 
+private:
+    // The six 2x2 minors of the top two rows (s) and of the bottom two rows
+    // (c); the determinant and every cofactor are built from them.
+    struct Minors {
+        double s[6];
+        double c[6];
+
+        double determinant() const {
+            return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+        }
+    };
+
+    Minors minors() const {
+        Minors k;
+        k.s[0] = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        k.s[1] = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        k.s[2] = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        k.s[3] = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        k.s[4] = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        k.s[5] = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+        k.c[0] = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+        k.c[1] = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        k.c[2] = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        k.c[3] = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        k.c[4] = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        k.c[5] = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        return k;
+    }
 
 };
 
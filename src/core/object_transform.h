@@ -0,0 +1,115 @@
+#ifndef OBJECT_TRANSFORM_H
+#define OBJECT_TRANSFORM_H
+
+#include <cmath>
+#include <stdexcept>
+
+#include "boundingbox.h"
+#include "matrix4x4.h"
+#include "ray.h"
+#include "vec3.h"
+
+// Where an object's own geometry sits in the world: a local-to-world matrix
+// and its inverse. Objects that keep one take transforms by composing them
+// here, whatever their cost to the geometry, and intersect rays mapped into
+// their own space. The mapped ray keeps the world ray's parameter, so hit
+// distances need no conversion. The identity, the default, maps nothing.
+class ObjectTransform {
+public:
+    bool is_identity() const {
+        return identity;
+    }
+
+    const Matrix4x4& get_local_to_world() const {
+        return local_to_world;
+    }
+
+    const Matrix4x4& get_world_to_local() const {
+        return world_to_local;
+    }
+
+    // Applies 'matrix' after the current placement. Throws, leaving the
+    // placement as it was, if the result cannot be inverted.
+    void apply(const Matrix4x4& matrix) {
+        Matrix4x4 composed = matrix * local_to_world;
+        world_to_local = composed.inverse();
+        local_to_world = composed;
+        identity = false;
+    }
+
+    // 'r' in local space, with a direction that is no longer unit length if
+    // the placement scales
+    ray to_local(const ray& r) const {
+        return identity ? r : r.transform(world_to_local);
+    }
+
+    point3 point_to_local(const point3& p) const {
+        return identity ? p : world_to_local.transform_point(p);
+    }
+
+    point3 point_to_world(const point3& p) const {
+        return identity ? p : local_to_world.transform_point(p);
+    }
+
+    // A local surface normal in world space, unit length unless the
+    // placement is the identity, which returns 'n' as it is. Normals map by
+    // the transpose of the inverse, which keeps them perpendicular to the
+    // surface under non-uniform scale and shear.
+    vec3 normal_to_world(const vec3& n) const {
+        if (identity) {
+            return n;
+        }
+        const auto& m = world_to_local.m;
+        return unit_vector(vec3(
+            m[0][0] * n.x() + m[1][0] * n.y() + m[2][0] * n.z(),
+            m[0][1] * n.x() + m[1][1] * n.y() + m[2][1] * n.z(),
+            m[0][2] * n.x() + m[1][2] * n.y() + m[2][2] * n.z()));
+    }
+
+    // Box around the image of the local box 'local'
+    BoundingBox bounds_to_world(const BoundingBox& local) const {
+        return identity ? local : transformed_bounds(local, local_to_world);
+    }
+
+    // Box around the preimage of the world box 'world'. Larger than it when
+    // the placement rotates, so tests against it are conservative.
+    BoundingBox bounds_to_local(const BoundingBox& world) const {
+        return identity ? world : transformed_bounds(world, world_to_local);
+    }
+
+    // True when 'matrix' only rotates, reflects, translates and scales
+    // uniformly: a shape given by a center, axes and radii can absorb it.
+    static bool is_similarity(const Matrix4x4& matrix) {
+        constexpr double tolerance = 1e-9;
+        const auto& m = matrix.m;
+        const dvec3 c0(m[0][0], m[1][0], m[2][0]);
+        const dvec3 c1(m[0][1], m[1][1], m[2][1]);
+        const dvec3 c2(m[0][2], m[1][2], m[2][2]);
+        const double s = c0.length_squared();
+        return s > 0.0
+            && std::fabs(c1.length_squared() - s) <= tolerance * s
+            && std::fabs(c2.length_squared() - s) <= tolerance * s
+            && std::fabs(dot(c0, c1)) <= tolerance * s
+            && std::fabs(dot(c0, c2)) <= tolerance * s
+            && std::fabs(dot(c1, c2)) <= tolerance * s;
+    }
+
+private:
+    Matrix4x4 local_to_world;
+    Matrix4x4 world_to_local;
+    bool identity = true;
+
+    static BoundingBox transformed_bounds(const BoundingBox& box, const Matrix4x4& matrix) {
+        const std::vector<point3> corners = box.getVertices();
+        point3 first = matrix.transform_point(corners[0]);
+        point3 vmin = first, vmax = first;
+        for (size_t i = 1; i < corners.size(); ++i) {
+            point3 p = matrix.transform_point(corners[i]);
+            vmin = vmin.cmin(p);
+            vmax = vmax.cmax(p);
+        }
+        return BoundingBox(vmin, vmax);
+    }
+};
+
+#endif // OBJECT_TRANSFORM_H
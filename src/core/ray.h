@@ -1,18 +1,32 @@
 #ifndef RAY_H
 #define RAY_H
 
+#include <cstdint>
+
 #include "vec3.h"
 #include "matrix4x4.h"
 
+// Kinds of rays, as bits of a visibility mask. Each object lists the kinds
+// that can hit it (see hittable::set_ray_visibility()).
+enum RayVisibility : uint8_t {
+    CameraRays = 1 << 0,
+    ShadowRays = 1 << 1,
+    ReflectionRays = 1 << 2,
+    AllRays = CameraRays | ShadowRays | ReflectionRays
+};
+
 class ray {
 public:
     ray() {}
 
-    ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}
+    ray(const point3& origin, const vec3& direction, uint8_t kind = AllRays) : orig(origin), dir(direction), ray_kind(kind) {}
 
     const point3& origin() const { return orig; }
     const vec3& direction() const { return dir; }
 
+    // RayVisibility bits of the objects this ray can hit
+    uint8_t kind() const { return ray_kind; }
+
     point3 at(double t) const {
         return orig + t * dir;
     }
@@ -25,12 +39,13 @@ public:
         // Transform the direction as a vector (ignores translation)
         vec3 new_direction = matrix.transform_vector(dir);
 
-        return ray(new_origin, new_direction);
+        return ray(new_origin, new_direction, ray_kind);
     }
 
 private:
     point3 orig;
     vec3 dir;
+    uint8_t ray_kind = AllRays;
 };
 
 #endif
\ No newline at end of file
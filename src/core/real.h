@@ -0,0 +1,16 @@
+#ifndef REAL_H
+#define REAL_H
+
+// Scalar type of stored geometry: vectors, points and colors, rays, bounding
+// boxes, intervals and hit records. Double by default; building with
+// RAYTRACER_SINGLE_PRECISION defined (the CMake option of the same name)
+// switches it to float, halving the memory that traversal reads. Code that
+// needs the precision whatever the mode, like the torus quartic, computes in
+// double explicitly.
+#ifdef RAYTRACER_SINGLE_PRECISION
+using real = float;
+#else
+using real = double;
+#endif
+
+#endif // REAL_H
@@ -0,0 +1,86 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Four doubles handled as one value, for the row-at-a-time products and
+// inverse of Matrix4x4. The instruction set is chosen at compile time from
+// what the compiler targets: one AVX register (with fused multiply-add when
+// FMA is available), two SSE2 registers, or plain doubles elsewhere. Build
+// with the CMake option RAYTRACER_NATIVE_ARCH to let the compiler target the
+// build machine's AVX and FMA; the default build stays on the SSE2 baseline.
+//
+// Without FMA every lane rounds exactly like the scalar expression it
+// replaces, so results do not depend on the instruction set.
+
+#if defined(__AVX__)
+#define RAYTRACER_SIMD_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAYTRACER_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(RAYTRACER_SIMD_AVX) && (defined(__FMA__) || defined(__AVX2__))
+#define RAYTRACER_SIMD_FMA 1
+#endif
+
+struct double4 {
+#if defined(RAYTRACER_SIMD_AVX)
+    __m256d v;
+
+    double4() : v(_mm256_setzero_pd()) {}
+    explicit double4(__m256d v) : v(v) {}
+    double4(double a, double b, double c, double d) : v(_mm256_set_pd(d, c, b, a)) {}
+
+    static double4 load(const double* p) { return double4(_mm256_loadu_pd(p)); }
+    static double4 broadcast(double s) { return double4(_mm256_set1_pd(s)); }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+    friend double4 operator+(const double4& a, const double4& b) { return double4(_mm256_add_pd(a.v, b.v)); }
+    friend double4 operator-(const double4& a, const double4& b) { return double4(_mm256_sub_pd(a.v, b.v)); }
+    friend double4 operator*(const double4& a, const double4& b) { return double4(_mm256_mul_pd(a.v, b.v)); }
+#elif defined(RAYTRACER_SIMD_SSE2)
+    __m128d lo, hi;
+
+    double4() : lo(_mm_setzero_pd()), hi(_mm_setzero_pd()) {}
+    double4(__m128d lo, __m128d hi) : lo(lo), hi(hi) {}
+    double4(double a, double b, double c, double d) : lo(_mm_set_pd(b, a)), hi(_mm_set_pd(d, c)) {}
+
+    static double4 load(const double* p) { return double4(_mm_loadu_pd(p), _mm_loadu_pd(p + 2)); }
+    static double4 broadcast(double s) { return double4(_mm_set1_pd(s), _mm_set1_pd(s)); }
+    void store(double* p) const { _mm_storeu_pd(p, lo); _mm_storeu_pd(p + 2, hi); }
+
+    friend double4 operator+(const double4& a, const double4& b) { return double4(_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)); }
+    friend double4 operator-(const double4& a, const double4& b) { return double4(_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)); }
+    friend double4 operator*(const double4& a, const double4& b) { return double4(_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)); }
+#else
+    double e[4];
+
+    double4() : e{0, 0, 0, 0} {}
+    double4(double a, double b, double c, double d) : e{a, b, c, d} {}
+
+    static double4 load(const double* p) { return double4(p[0], p[1], p[2], p[3]); }
+    static double4 broadcast(double s) { return double4(s, s, s, s); }
+    void store(double* p) const { p[0] = e[0]; p[1] = e[1]; p[2] = e[2]; p[3] = e[3]; }
+
+    friend double4 operator+(const double4& a, const double4& b) { return double4(a.e[0] + b.e[0], a.e[1] + b.e[1], a.e[2] + b.e[2], a.e[3] + b.e[3]); }
+    friend double4 operator-(const double4& a, const double4& b) { return double4(a.e[0] - b.e[0], a.e[1] - b.e[1], a.e[2] - b.e[2], a.e[3] - b.e[3]); }
+    friend double4 operator*(const double4& a, const double4& b) { return double4(a.e[0] * b.e[0], a.e[1] * b.e[1], a.e[2] * b.e[2], a.e[3] * b.e[3]); }
+#endif
+
+    double operator[](int i) const {
+        double lanes[4];
+        store(lanes);
+        return lanes[i];
+    }
+};
+
+// a * b + c, fused into one rounding where the target has FMA
+inline double4 multiply_add(const double4& a, const double4& b, const double4& c) {
+#if defined(RAYTRACER_SIMD_FMA)
+    return double4(_mm256_fmadd_pd(a.v, b.v, c.v));
+#else
+    return a * b + c;
+#endif
+}
+
+#endif // SIMD_H
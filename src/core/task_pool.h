@@ -0,0 +1,325 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Queue a task is submitted to. Idle workers always take interactive work
+// (the frame being traced) before background work (BVH and octree builds,
+// asset loading, the preview while a final render runs). Tasks are not
+// preempted, so background work is split into pieces that finish quickly, and
+// background loops hand their worker back when interactive work is waiting.
+enum class TaskLane {
+    Interactive,
+    Background
+};
+
+// One set of worker threads shared by the whole engine, created on first use.
+// All entry points are fork-join: the calling thread takes part in the work and
+// never waits for a task that no thread has started, so parallel code may be
+// nested (a task may itself use the pool) without oversubscribing the machine
+// or deadlocking.
+class TaskPool {
+public:
+    static TaskPool& shared() {
+        static TaskPool pool;
+        return pool;
+    }
+
+    explicit TaskPool(int worker_count = default_worker_count()) {
+        for (int i = 0; i < worker_count; ++i) {
+            workers.emplace_back(&TaskPool::work, this);
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Threads that can work on one job: the workers plus the caller.
+    int concurrency() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    // Lane of work submitted from the calling thread when none is given.
+    static TaskLane current_lane() {
+        return thread_lane();
+    }
+
+    // Sets the calling thread's default lane for its lifetime.
+    class LaneScope {
+    public:
+        explicit LaneScope(TaskLane lane) : previous(thread_lane()) { thread_lane() = lane; }
+        ~LaneScope() { thread_lane() = previous; }
+        LaneScope(const LaneScope&) = delete;
+        LaneScope& operator=(const LaneScope&) = delete;
+    private:
+        TaskLane previous;
+    };
+
+    // True when a worker looping over 'lane' work should return so that waiting
+    // interactive work can start. The caller's own slot never yields.
+    bool should_yield(TaskLane lane) const {
+        return lane == TaskLane::Background && interactive_waiting.load(std::memory_order_relaxed) > 0;
+    }
+
+    // Runs worker(slot) on the caller (slot 0) and on every pool worker that
+    // becomes free before the caller's call returns (slots 1, 2, ...). Each call
+    // must claim work from shared state until none is left (slots other than 0
+    // may stop early, see should_yield). Returns once every started call has
+    // finished; rethrows the first exception thrown.
+    template <typename Worker>
+    void run_workers(TaskLane lane, Worker&& worker) {
+        auto state = std::make_shared<WorkerState>();
+        std::function<void(int)> body = std::forward<Worker>(worker);
+        state->body = &body;
+
+        for (size_t i = 0; i < workers.size(); ++i) {
+            enqueue(lane, [state] {
+                int slot;
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->closed) {
+                        return;   // The job finished before this worker got to it
+                    }
+                    slot = state->next_slot++;
+                    ++state->active;
+                }
+                state->run(slot);
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    --state->active;
+                }
+                state->cv.notify_all();
+            });
+        }
+
+        state->run(0);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->closed = true;
+        state->cv.wait(lock, [&state] { return state->active == 0; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    // Calls body(i) for every i in [begin, end), handing out indices in order.
+    template <typename Body>
+    void parallel_for(int begin, int end, Body&& body, TaskLane lane = current_lane()) {
+        if (end - begin <= 1 || workers.empty()) {
+            for (int i = begin; i < end; ++i) {
+                body(i);
+            }
+            return;
+        }
+
+        std::atomic<int> next(begin);
+        run_workers(lane, [&](int slot) {
+            while (slot == 0 || !should_yield(lane)) {
+                int i = next++;
+                if (i >= end) {
+                    return;
+                }
+                body(i);
+            }
+        });
+    }
+
+    // Queues a task. Only the fork-join helpers above and TaskGroup use it,
+    // since a bare task gives the caller nothing to wait on.
+    void enqueue(TaskLane lane, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (lane == TaskLane::Interactive) {
+                interactive.push_back(std::move(task));
+                ++interactive_waiting;
+            }
+            else {
+                background.push_back(std::move(task));
+            }
+        }
+        cv.notify_one();
+    }
+
+private:
+    struct WorkerState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        const std::function<void(int)>* body = nullptr;
+        int next_slot = 1;
+        int active = 0;
+        bool closed = false;
+        std::exception_ptr error;
+
+        void run(int slot) {
+            try {
+                (*body)(slot);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    static TaskLane& thread_lane() {
+        thread_local TaskLane lane = TaskLane::Interactive;
+        return lane;
+    }
+
+    // One thread per core, minus the thread that submits the work.
+    static int default_worker_count() {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(cores - 1, 0);
+    }
+
+    void work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !interactive.empty() || !background.empty(); });
+                if (stopping) {
+                    return;
+                }
+                if (!interactive.empty()) {
+                    task = std::move(interactive.front());
+                    interactive.pop_front();
+                    --interactive_waiting;
+                }
+                else {
+                    task = std::move(background.front());
+                    background.pop_front();
+                }
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> interactive;
+    std::deque<std::function<void()>> background;
+    std::atomic<int> interactive_waiting{ 0 };   // Size of 'interactive', readable without the lock
+    bool stopping = false;
+};
+
+// Fork-join group for recursive or heterogeneous work (BVH subtrees, octree
+// children, files to load). run() queues a job; wait() runs every job no
+// worker has started yet on the calling thread, newest first (workers take the
+// oldest), then waits for the rest.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskLane lane = TaskLane::Background, TaskPool& pool = TaskPool::shared())
+        : lane(lane), pool(pool), state(std::make_shared<GroupState>()) {
+    }
+
+    ~TaskGroup() {
+        try {
+            wait();
+        }
+        catch (...) {
+            // Errors are reported by an explicit wait()
+        }
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename Job>
+    void run(Job&& job) {
+        auto entry = std::make_shared<Entry>();
+        entry->job = std::forward<Job>(job);
+        jobs.push_back(entry);
+
+        if (pool.concurrency() > 1) {
+            pool.enqueue(lane, [state = state, entry] { state->execute(*entry); });
+        }
+    }
+
+    void wait() {
+        for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+            state->execute(**it);
+        }
+        jobs.clear();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [this] { return state->running == 0; });
+        if (state->error) {
+            std::exception_ptr error = state->error;
+            state->error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Entry {
+        bool claimed = false;   // Guarded by GroupState::mutex
+        std::function<void()> job;
+    };
+
+    struct GroupState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        int running = 0;
+        std::exception_ptr error;
+
+        // Runs the job unless another thread already took it.
+        void execute(Entry& entry) {
+            {
+                // Claiming and counting under one lock, so wait() cannot miss a
+                // job that was just taken
+                std::lock_guard<std::mutex> lock(mutex);
+                if (entry.claimed) {
+                    return;
+                }
+                entry.claimed = true;
+                ++running;
+            }
+            try {
+                entry.job();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --running;
+            }
+            cv.notify_all();
+        }
+    };
+
+    TaskLane lane;
+    TaskPool& pool;
+    std::shared_ptr<GroupState> state;
+    std::vector<std::shared_ptr<Entry>> jobs;
+};
+
+#endif // TASK_POOL_H
@@ -5,113 +5,119 @@
 #include <iostream>
 #include <algorithm>
 
-// Forward declaration of vec3
-class vec3;
+#include "real.h"
 
-vec3 operator/(const vec3& v, double t);
-
-class vec3 {
+// 3D vector of any scalar type. Geometry uses vec3, whose components are
+// 'real' (see real.h); dvec3 is for computations that always need double.
+template <typename T>
+class vec3_t {
 public:
-    double e[3];
+    using scalar = T;
+
+    T e[3];
 
     // Constructors
-    vec3() : e{0.0, 0.0, 0.0} {}
-    vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+    vec3_t() : e{0, 0, 0} {}
+    vec3_t(T e0, T e1, T e2) : e{e0, e1, e2} {}
+
+    // Conversion between precisions, kept explicit so that it shows
+    template <typename U>
+    explicit vec3_t(const vec3_t<U>& v) : e{static_cast<T>(v.e[0]), static_cast<T>(v.e[1]), static_cast<T>(v.e[2])} {}
 
     // Static function to create a vec3 with all components set to the same value
-    static vec3 fill(double value) {
-        return vec3(value, value, value);
+    static vec3_t fill(T value) {
+        return vec3_t(value, value, value);
     }
 
     // Accessors
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
 
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-    double operator[](size_t i) const { return e[i]; }
-    double& operator[](size_t i) { return e[i]; }
+    vec3_t operator-() const { return vec3_t(-e[0], -e[1], -e[2]); }
+    T operator[](size_t i) const { return e[i]; }
+    T& operator[](size_t i) { return e[i]; }
 
-    vec3& operator+=(const vec3& v) {
+    vec3_t& operator+=(const vec3_t& v) {
         e[0] += v.e[0];
         e[1] += v.e[1];
         e[2] += v.e[2];
         return *this;
     }
 
-    vec3& operator*=(double t) {
+    vec3_t& operator*=(T t) {
         e[0] *= t;
         e[1] *= t;
         e[2] *= t;
         return *this;
     }
 
-    vec3& operator/=(double t) {
+    vec3_t& operator/=(T t) {
         return *this *= 1.0 / t;
     }
 
-    vec3& operator*=(const vec3& v) {
+    vec3_t& operator*=(const vec3_t& v) {
         e[0] *= v.e[0];
         e[1] *= v.e[1];
         e[2] *= v.e[2];
         return *this;
     }
 
-    vec3& operator/=(const vec3& v) {
+    vec3_t& operator/=(const vec3_t& v) {
         e[0] /= v.e[0];
         e[1] /= v.e[1];
         e[2] /= v.e[2];
         return *this;
     }
 
-    bool operator==(const vec3& other) const {
+    bool operator==(const vec3_t& other) const {
         return e[0] == other.e[0] && e[1] == other.e[1] && e[2] == other.e[2];
     }
 
-    bool operator!=(const vec3& other) const {
+    bool operator!=(const vec3_t& other) const {
         return !(*this == other);
     }
 
-    double length() const {
+    T length() const {
         return std::sqrt(length_squared());
     }
 
-    double length_squared() const {
+    T length_squared() const {
         return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
     }
 
-    vec3 abs() const {
-        return vec3(std::abs(e[0]), std::abs(e[1]), std::abs(e[2]));
+    vec3_t abs() const {
+        return vec3_t(std::abs(e[0]), std::abs(e[1]), std::abs(e[2]));
     }
 
-    vec3 cmax(const vec3& v) const {
-        return vec3(std::max(e[0], v.e[0]),
-                    std::max(e[1], v.e[1]),
-                    std::max(e[2], v.e[2]));
+    vec3_t cmax(const vec3_t& v) const {
+        return vec3_t(std::max(e[0], v.e[0]),
+                      std::max(e[1], v.e[1]),
+                      std::max(e[2], v.e[2]));
     }
 
-    vec3 cmin(const vec3& v) const {
-        return vec3(std::min(e[0], v.e[0]),
-                    std::min(e[1], v.e[1]),
-                    std::min(e[2], v.e[2]));
+    vec3_t cmin(const vec3_t& v) const {
+        return vec3_t(std::min(e[0], v.e[0]),
+                      std::min(e[1], v.e[1]),
+                      std::min(e[2], v.e[2]));
     }
 
-    double max() const {
+    T max() const {
         return std::max({e[0], e[1], e[2]});
     }
 
-    double min() const {
+    T min() const {
         return std::min({e[0], e[1], e[2]});
     }
 
-    vec3 inverse() const {
-        return vec3(1.0 / e[0], 1.0 / e[1], 1.0 / e[2]);
+    vec3_t inverse() const {
+        return vec3_t(1.0 / e[0], 1.0 / e[1], 1.0 / e[2]);
     }
 
     // Returns a *new* normalized vector. Leaves the original unchanged.
-    vec3 normalized() const {
-        double len = length();
-        return (len > 0.0) ? (*this / len) : vec3();
+    vec3_t normalized() const {
+        T len = length();
+        return (len > 0.0) ? (*this / len) : vec3_t();
     }
 
     // In-place normalization. Modifies the current vector.
@@ -120,92 +126,112 @@ public:
     }
 };
 
+using vec3 = vec3_t<real>;
+using dvec3 = vec3_t<double>;
+
 // Alias for geometric clarity
 using point3 = vec3;
 
-// Vector Utility Functions
-inline std::ostream& operator<<(std::ostream& out, const vec3& v) {
+// Vector Utility Functions. Scalars are taken as the vector's own type
+// ('typename vec3_t<T>::scalar' is not deduced), so doubles and ints mix with
+// vectors of either precision.
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const vec3_t<T>& v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
-inline vec3 operator+(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] + v.e[0],
-                u.e[1] + v.e[1],
-                u.e[2] + v.e[2]);
+template <typename T>
+inline vec3_t<T> operator+(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] + v.e[0],
+                     u.e[1] + v.e[1],
+                     u.e[2] + v.e[2]);
 }
 
-inline vec3 operator-(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] - v.e[0],
-                u.e[1] - v.e[1],
-                u.e[2] - v.e[2]);
+template <typename T>
+inline vec3_t<T> operator-(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] - v.e[0],
+                     u.e[1] - v.e[1],
+                     u.e[2] - v.e[2]);
 }
 
 // Component-wise multiplication
-inline vec3 operator*(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] * v.e[0],
-                u.e[1] * v.e[1],
-                u.e[2] * v.e[2]);
+template <typename T>
+inline vec3_t<T> operator*(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] * v.e[0],
+                     u.e[1] * v.e[1],
+                     u.e[2] * v.e[2]);
 }
 
 // Scalar multiplication
-inline vec3 operator*(double t, const vec3& v) {
-    return vec3(t * v.e[0],
-                t * v.e[1],
-                t * v.e[2]);
+template <typename T>
+inline vec3_t<T> operator*(typename vec3_t<T>::scalar t, const vec3_t<T>& v) {
+    return vec3_t<T>(t * v.e[0],
+                     t * v.e[1],
+                     t * v.e[2]);
 }
 
-inline vec3 operator*(const vec3& v, double t) {
+template <typename T>
+inline vec3_t<T> operator*(const vec3_t<T>& v, typename vec3_t<T>::scalar t) {
     return t * v;
 }
 
 // Component-wise division
-inline vec3 operator/(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] / v.e[0],
-                u.e[1] / v.e[1],
-                u.e[2] / v.e[2]);
+template <typename T>
+inline vec3_t<T> operator/(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] / v.e[0],
+                     u.e[1] / v.e[1],
+                     u.e[2] / v.e[2]);
 }
 
 // Scalar division
-inline vec3 operator/(const vec3& v, double t) {
+template <typename T>
+inline vec3_t<T> operator/(const vec3_t<T>& v, typename vec3_t<T>::scalar t) {
     return (1.0 / t) * v;
 }
 
-inline vec3 operator/(double t, const vec3& v) {
-    return vec3(t / v.e[0],
-                t / v.e[1],
-                t / v.e[2]);
+template <typename T>
+inline vec3_t<T> operator/(typename vec3_t<T>::scalar t, const vec3_t<T>& v) {
+    return vec3_t<T>(t / v.e[0],
+                     t / v.e[1],
+                     t / v.e[2]);
 }
 
-inline double dot(const vec3& u, const vec3& v) {
+template <typename T>
+inline T dot(const vec3_t<T>& u, const vec3_t<T>& v) {
     return u.e[0] * v.e[0] +
            u.e[1] * v.e[1] +
            u.e[2] * v.e[2];
 }
 
-inline vec3 cross(const vec3& u, const vec3& v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+template <typename T>
+inline vec3_t<T> cross(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                     u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                     u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline vec3 unit_vector(const vec3& v) {
+template <typename T>
+inline vec3_t<T> unit_vector(const vec3_t<T>& v) {
     return v / v.length();
 }
 
-inline vec3 step(const vec3& edge, const vec3& v) {
-    return vec3((v.e[0] >= edge.e[0]),
-                (v.e[1] >= edge.e[1]),
-                (v.e[2] >= edge.e[2]));
+template <typename T>
+inline vec3_t<T> step(const vec3_t<T>& edge, const vec3_t<T>& v) {
+    return vec3_t<T>((v.e[0] >= edge.e[0]),
+                     (v.e[1] >= edge.e[1]),
+                     (v.e[2] >= edge.e[2]));
 }
 
-inline vec3 sign(const vec3& v) {
-    return vec3((v.e[0] > 0.0) - (v.e[0] < 0.0),
-                (v.e[1] > 0.0) - (v.e[1] < 0.0),
-                (v.e[2] > 0.0) - (v.e[2] < 0.0));
+template <typename T>
+inline vec3_t<T> sign(const vec3_t<T>& v) {
+    return vec3_t<T>((v.e[0] > 0.0) - (v.e[0] < 0.0),
+                     (v.e[1] > 0.0) - (v.e[1] < 0.0),
+                     (v.e[2] > 0.0) - (v.e[2] < 0.0));
 }
 
-inline vec3 reflect(const vec3& I, const vec3& N) {
+template <typename T>
+inline vec3_t<T> reflect(const vec3_t<T>& I, const vec3_t<T>& N) {
     return I - 2.0 * dot(I, N) * N;
 }
 
-#endif // VEC3_H
\ No newline at end of file
+#endif // VEC3_H
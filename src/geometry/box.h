@@ -47,15 +47,23 @@ public:
 
     // Ray hit function for the box
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!hit_closest(r, ray_t, rec)) {
+            return false;
+        }
+        complete_pending_hit(r, rec);
+        return true;
+    }
+
+    // The closest face is left pending
+    bool hit_closest(const ray& r, interval ray_t, hit_record& rec) const override {
         bool hit_anything = false;
         double closest_so_far = ray_t.max;
 
         for (const auto& tri : triangles) {
-            hit_record temp_rec;
-            if (tri->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            if (tri->hit_closest(r, interval(ray_t.min, closest_so_far), rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
+                rec.hit_object = this;
             }
         }
 
@@ -99,6 +107,10 @@ public:
         return std::make_shared<box>(*this);
     }
 
+    const std::vector<std::shared_ptr<triangle>>& getTriangles() const {
+        return triangles;
+    }
+
 private:
     point3 vmin;
     point3 vmax;
@@ -216,15 +216,15 @@ public:
 
         // Compute the min and max points for the bounding box
         point3 min_point(
-            std::min(base_center.x() - radius, top_vertex.x()),
-            std::min(base_center.y() - radius, top_vertex.y()),
-            std::min(base_center.z() - radius, top_vertex.z())
+            std::min<real>(base_center.x() - radius, top_vertex.x()),
+            std::min<real>(base_center.y() - radius, top_vertex.y()),
+            std::min<real>(base_center.z() - radius, top_vertex.z())
         );
 
         point3 max_point(
-            std::max(base_center.x() + radius, top_vertex.x()),
-            std::max(base_center.y() + radius, top_vertex.y()),
-            std::max(base_center.z() + radius, top_vertex.z())
+            std::max<real>(base_center.x() + radius, top_vertex.x()),
+            std::max<real>(base_center.y() + radius, top_vertex.y()),
+            std::max<real>(base_center.z() + radius, top_vertex.z())
         );
 
         return BoundingBox(min_point, max_point);
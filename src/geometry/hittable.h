@@ -19,6 +19,23 @@ public:
     // Pure virtual function: must be implemented by derived classes
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
 
+    // Closest hit like hit(), except that the surface attributes may be left
+    // for complete_hit(): then only rec.t and rec.hit_object are set, and
+    // rec.pending names the primitive that finishes the record. Traversals
+    // that test many candidates use this and complete only the hit they keep
+    // (see complete_pending_hit()).
+    virtual bool hit_closest(const ray& r, interval ray_t, hit_record& rec) const {
+        if (!hit(r, ray_t, rec)) {
+            return false;
+        }
+        rec.pending = nullptr;
+        return true;
+    }
+
+    // Fills in the attributes hit_closest() left out of 'rec'.
+    virtual void complete_hit(const ray&, hit_record&) const {
+    }
+
     // Default function for non csg objects
     virtual bool csg_intersect(const ray& r, interval ray_t,
         std::vector<CSGIntersection>& out_intersections) const
@@ -57,6 +74,11 @@ public:
         return mat(color(1.0f, 1.0f, 1.0f)); // Default white material
     }
 
+    // True if any part of the object mirrors its surroundings.
+    virtual bool is_reflective() const {
+        return get_material().reflection > 0.0;
+    }
+
     virtual void set_material(const mat& material) {
         throw std::runtime_error("set_material not supported for this object.");
     }
@@ -64,6 +86,31 @@ public:
     virtual std::shared_ptr<hittable> clone() const {
         throw std::runtime_error("Copy not supported for this object.");
     }
+
+    // RayVisibility bits of the rays that can hit the object; the others pass
+    // through it. Containers such as BVHNode hold the union of their children.
+    uint8_t get_ray_visibility() const {
+        return ray_visibility;
+    }
+
+    void set_ray_visibility(uint8_t mask) {
+        ray_visibility = mask;
+    }
+
+    bool is_visible_to(const ray& r) const {
+        return (ray_visibility & r.kind()) != 0;
+    }
+
+protected:
+    uint8_t ray_visibility = AllRays;
 };
 
+// Finishes a record returned by hit_closest(), if anything is left to do.
+inline void complete_pending_hit(const ray& r, hit_record& rec) {
+    if (const hittable* object = rec.pending) {
+        rec.pending = nullptr;
+        object->complete_hit(r, rec);
+    }
+}
+
 #endif
\ No newline at end of file
@@ -8,11 +8,14 @@
 #include <unordered_map>
 #include <memory>
 #include "vec3.h"
+#include "object_transform.h"
 #include "scene.h"
 #include "material.h"
 #include "bvh_node.h"
 #include "triangle.h"
 
+// Triangles stay in the mesh's own space, where its BVH is built; transforms
+// only change its placement, and rays are mapped into that space.
 class Mesh : public hittable {
 public:
     Mesh() {}
@@ -23,24 +26,50 @@ public:
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        if (root_bvh) {
-            return root_bvh->hit(r, ray_t, rec);
+        if (!hit_closest(r, ray_t, rec)) {
+            return false;
         }
-        else {
-            return defaultHitTraversal(r, ray_t, rec);
+        complete_pending_hit(r, rec);
+        return true;
+    }
+
+    // The closest triangle is left pending; behind the mesh itself if the
+    // triangle has to be completed in local space
+    bool hit_closest(const ray& r, interval ray_t, hit_record& rec) const override {
+        const ray local = placement.to_local(r);
+        bool hit_anything = root_bvh ? root_bvh->hit_closest(local, ray_t, rec) : defaultHitTraversal(local, ray_t, rec);
+
+        // Report the mesh, not the individual triangle, as the object that was hit
+        if (hit_anything) {
+            rec.hit_object = this;
+            if (!placement.is_identity()) {
+                rec.pending_part = rec.pending;
+                rec.pending = this;
+            }
         }
+        return hit_anything;
     }
 
+    void complete_hit(const ray& r, hit_record& rec) const override {
+        const hittable* part = rec.pending_part;
+        rec.pending_part = nullptr;
+        part->complete_hit(placement.to_local(r), rec);
+        rec.p = r.at(rec.t);
+        rec.normal = placement.normal_to_world(rec.normal);
+    }
+
+    // Only the placement changes; the triangles and their BVH stay as they are
     void transform(const Matrix4x4& matrix) override {
-        for (auto& tri : triangles) {
-            tri->transform(matrix);
-        }
-        buildBVH(); // Rebuild BVH after transformation
+        placement.apply(matrix);
+    }
+
+    const ObjectTransform& get_placement() const {
+        return placement;
     }
 
     BoundingBox bounding_box() const override {
         if (root_bvh) {
-            return root_bvh->bounding_box();  // Use BVH bounding box if available
+            return placement.bounds_to_world(root_bvh->bounding_box());  // Use BVH bounding box if available
         }
 
         if (triangles.empty()) {
@@ -51,7 +80,7 @@ public:
         for (size_t i = 1; i < triangles.size(); ++i) {
             combined_box = combined_box.enclose(triangles[i]->bounding_box());
         }
-        return combined_box;
+        return placement.bounds_to_world(combined_box);
     }
 
     std::string get_type_name() const override {
@@ -68,6 +97,15 @@ public:
         return triangles.empty() ? mat() : triangles[0]->get_material();
     }
 
+    bool is_reflective() const override {
+        for (const auto& tri : triangles) {
+            if (tri->is_reflective()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     void buildBVH() {
         if (!triangles.empty()) {
             std::vector<std::shared_ptr<hittable>> hittable_triangles;
@@ -85,8 +123,8 @@ public:
         return triangles;
     }
 
-    bool is_point_inside(const point3& p) const override {
-
+    bool is_point_inside(const point3& world_p) const override {
+        const point3 p = placement.point_to_local(world_p);
         for (const auto& tri : triangles)
         {
             if (tri->bounding_box().contains(p))
@@ -102,11 +140,13 @@ public:
         return false;
     }
 
-    char test_bb(const BoundingBox& bb) const override {
+    // Tests the triangles against the box around 'world_bb' in local space
+    char test_bb(const BoundingBox& world_bb) const override {
         // Fast rejection: if the bounding box doesn't intersect the mesh's bounding box, return 'w'
-        if (!bb.intersects(this->bounding_box())) {
+        if (!world_bb.intersects(this->bounding_box())) {
             return 'w';
         }
+        const BoundingBox bb = placement.bounds_to_local(world_bb);
 
         // Iterate through all triangles in the mesh
         bool all_corners_inside_any_triangle = true;
@@ -139,6 +179,7 @@ public:
         }
 
         newMesh->buildBVH(); // Rebuild BVH for the new mesh
+        newMesh->placement = placement;
         return newMesh;
     }
 
@@ -149,17 +190,16 @@ public:
 private:
     std::vector<std::shared_ptr<triangle>> triangles;
     std::shared_ptr<BVHNode> root_bvh = nullptr;
+    ObjectTransform placement;
 
     bool defaultHitTraversal(const ray& r, interval ray_t, hit_record& rec) const {
-        hit_record temp_rec;
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;
 
         for (const auto& tri : triangles) {
-            if (tri->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            if (tri->hit_closest(r, interval(ray_t.min, closest_so_far), rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
             }
         }
         return hit_anything;
@@ -259,7 +299,9 @@ inline MeshData load_obj(const std::string& filepath, const std::unordered_map<s
     return model;
 }
 
-inline ObjectID add_mesh_to_scene(const std::string& filepath, SceneManager& manager, const std::string& mtl_path = "", const mat& default_material = mat()) {
+// Parses an OBJ (and optional MTL) file into a mesh with its BVH built. Touches
+// no shared state, so several meshes can be loaded concurrently.
+inline std::shared_ptr<Mesh> load_mesh(const std::string& filepath, const std::string& mtl_path = "", const mat& default_material = mat()) {
     std::unordered_map<std::string, MaterialData> materials;
 
     if (!mtl_path.empty()) {
@@ -295,8 +337,11 @@ inline ObjectID add_mesh_to_scene(const std::string& filepath, SceneManager& man
     }
 
     mesh->buildBVH();
+    return mesh;
+}
 
-    return manager.add(mesh);
+inline ObjectID add_mesh_to_scene(const std::string& filepath, SceneManager& manager, const std::string& mtl_path = "", const mat& default_material = mat()) {
+    return manager.add(load_mesh(filepath, mtl_path, default_material));
 }
 
 // Helper function that spawns an array of a mesh.
@@ -4,6 +4,7 @@
 #include <vector>
 #include <cassert>
 #include "boundingbox.h"
+#include "task_pool.h"
 
 class OctreeNode {
 public:
@@ -30,7 +31,8 @@ public:
     //  - 'w' for completely outside,
     //  - 'b' for completely inside,
     //  - and any other value for a partial intersection.)
-    static OctreeNode FromObject(const BoundingBox& bb, const hittable& obj, int depth_limit = 3) {
+    // With 'parallel' set, the eight children are built as TaskPool jobs.
+    static OctreeNode FromObject(const BoundingBox& bb, const hittable& obj, int depth_limit = 3, bool parallel = false) {
         OctreeNode root = EmptyNode();
         char test = obj.test_bb(bb);
 
@@ -45,8 +47,19 @@ public:
         else {
             // Partial intersection, subdivide
             root.subdivide();
-            for (int i = 0; i < 8; i++) {
-                root.children[i] = FromObject(bb.subdivide(i), obj, depth_limit - 1);
+            if (parallel) {
+                TaskGroup children(TaskLane::Background);
+                for (int i = 0; i < 8; i++) {
+                    children.run([&root, &bb, &obj, depth_limit, i] {
+                        root.children[i] = FromObject(bb.subdivide(i), obj, depth_limit - 1);
+                    });
+                }
+                children.wait();
+            }
+            else {
+                for (int i = 0; i < 8; i++) {
+                    root.children[i] = FromObject(bb.subdivide(i), obj, depth_limit - 1);
+                }
             }
             return root;
         }
@@ -19,6 +19,14 @@ public:
     }
 
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!hit_closest(r, ray_t, rec)) {
+            return false;
+        }
+        complete_pending_hit(r, rec);
+        return true;
+    }
+
+    bool hit_closest(const ray& r, interval ray_t, hit_record& rec) const override {
         // Compute the denominator of the intersection formula
         auto denom = dot(normal, r.direction());
 
@@ -35,18 +43,22 @@ public:
             return false;
         }
         rec.t = t;
+        rec.hit_object = this;
+        rec.pending = this;
+        return true;
+    }
+
+    void complete_hit(const ray& r, hit_record& rec) const override {
         rec.p = r.at(rec.t);
         rec.set_face_normal(r, normal);
         rec.material = &material;
-        rec.hit_object = this;
 
         // Calculate UV coordinates
         calculate_uv(rec.p, rec.u, rec.v);
-        return true;
     }
 
 
-    void calculate_uv(const point3& hit_point, double& u, double& v) const {
+    void calculate_uv(const point3& hit_point, real& u, real& v) const {
         // Compute vector from reference point to hit point
         vec3 local_vec = hit_point - point;
 
@@ -82,6 +94,9 @@ public:
         return "Plane";
     }
 
+    point3 get_point() const { return point; }
+    vec3 get_normal() const { return normal; }
+
     void set_material(const mat& new_material) override {
         material = new_material;
     }
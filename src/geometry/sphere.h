@@ -7,6 +7,7 @@
 #include "vec3.h"
 #include "material.h"
 #include "boundingbox.h"
+#include "object_transform.h"
 
 class sphere : public hittable {
 public:
@@ -31,6 +32,15 @@ public:
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!hit_closest(r, ray_t, rec)) {
+            return false;
+        }
+        complete_pending_hit(r, rec);
+        return true;
+    }
+
+    bool hit_closest(const ray& world_r, interval ray_t, hit_record& rec) const override {
+        const ray r = placement.to_local(world_r);
         vec3 oc = r.origin() - center;
         auto a = r.direction().length_squared();
         auto half_b = dot(oc, r.direction());
@@ -51,21 +61,26 @@ public:
         }
 
         rec.t = root;
+        rec.hit_object = this;
+        rec.pending = this;
+        return true;
+    }
+
+    void complete_hit(const ray& r, hit_record& rec) const override {
+        const point3 local_p = placement.to_local(r).at(rec.t);
+        vec3 outward_normal = (local_p - center) / radius;
         rec.p = r.at(rec.t);
-        vec3 outward_normal = (rec.p - center) / radius;
-        rec.set_face_normal(r, outward_normal);
+        rec.set_face_normal(r, placement.normal_to_world(outward_normal));
         rec.material = &material;
-        rec.hit_object = this;
 
         // Calculate UV coordinates
-        calculate_uv((rec.p - center) / radius, rec.u, rec.v);
-
-        return true;
+        calculate_uv(outward_normal, rec.u, rec.v);
     }
 
-    bool csg_intersect(const ray& r, interval ray_t,
+    bool csg_intersect(const ray& world_r, interval ray_t,
         std::vector<CSGIntersection>& out_intersections) const override {
         out_intersections.clear();
+        const ray r = placement.to_local(world_r);
 
         // Calculate basic intersection parameters
         vec3 oc = r.origin() - center;
@@ -96,7 +111,8 @@ public:
         // This helps with CSG operations that might need to know about all intersections
         if (std::isfinite(root1)) {
             vec3 hit_point = r.at(root1);
-            vec3 normal = (hit_point - center) / radius;
+            vec3 normal = placement.normal_to_world((hit_point - center) / radius);
+            hit_point = world_r.at(root1);
             // Entry point: normal points inward if ray starts inside
             if (ray_starts_inside) normal = -normal;
             out_intersections.emplace_back(
@@ -110,7 +126,8 @@ public:
 
         if (std::isfinite(root2)) {
             vec3 hit_point = r.at(root2);
-            vec3 normal = (hit_point - center) / radius;
+            vec3 normal = placement.normal_to_world((hit_point - center) / radius);
+            hit_point = world_r.at(root2);
             // Exit point: normal points outward if ray starts inside
             if (!ray_starts_inside) normal = -normal;
             out_intersections.emplace_back(
@@ -131,7 +148,7 @@ public:
         return !out_intersections.empty();
     }
 
-    void calculate_uv(const vec3& normal, double& u, double& v) const {
+    void calculate_uv(const vec3& normal, real& u, real& v) const {
         // Convert normal to spherical coordinates
         auto theta = std::acos(-normal.y())*0.5; // Latitude
         auto phi = std::atan2(-normal.z(), normal.x()) + M_PI; // Longitude
@@ -142,28 +159,39 @@ public:
     }
 
     bool is_point_inside(const point3& p) const override {
-        return (p - center).length() <= radius;
+        return (placement.point_to_local(p) - center).length() <= radius;
     }
 
     // Returns:
     // 'w' if the bounding box doesn't intersect the sphere (empty)
     // 'b' if the bounding box is completely inside the sphere (full)
     // 'g' otherwise (partial)
-    char test_bb(const BoundingBox& bb) const override {
+    // With a placement, tests the box around 'world_bb' in local space, which
+    // may answer 'g' for a box that is in fact empty or full
+    char test_bb(const BoundingBox& world_bb) const override {
+        const BoundingBox bb = placement.bounds_to_local(world_bb);
         point3 closest = bb.getClosestPoint(center);
-        if (!is_point_inside(closest)) {
+        if ((closest - center).length() > radius) {
             return 'w';
         }
 
         point3 furthest = bb.getFurthestPoint(center);
-        if (is_point_inside(furthest)) {
+        if ((furthest - center).length() <= radius) {
             return 'b';
         }
 
         return 'g';
     }
 
+    // Center and radius take translations, rotations and uniform scale. Any
+    // other transform, such as a non-uniform scale, turns the sphere into an
+    // ellipsoid held by its placement, which takes every later transform too.
     void transform(const Matrix4x4& matrix) override {
+        if (!placement.is_identity() || !ObjectTransform::is_similarity(matrix)) {
+            placement.apply(matrix);
+            return;
+        }
+
         // Apply transformation to the center of the sphere
         center = matrix.transform_point(center);
 
@@ -177,7 +205,7 @@ public:
         point3 min_point = center - vec3(radius, radius, radius);
         point3 max_point = center + vec3(radius, radius, radius);
 
-        return BoundingBox(min_point, max_point);
+        return placement.bounds_to_world(BoundingBox(min_point, max_point));
     }
 
     std::string get_type_name() const override {
@@ -192,6 +220,7 @@ private:
     point3 center;
     double radius;
     mat material;
+    ObjectTransform placement;
 };
 
 #endif
@@ -7,13 +7,14 @@
 #include "vec3.h"
 #include "material.h"
 #include "matrix4x4.h"
+#include "object_transform.h"
 
 // Computes intersection of a ray with a torus
 // ro: ray origin (in object space)
 // rd: ray direction (in object space)
 // major_radius: Radius from the torus center to the tube center
 // minor_radius: Radius of the tube itself
-static double compute_torus_intersection(const vec3& ray_origin, const vec3& ray_direction, double major_radius, double minor_radius) {
+static double compute_torus_intersection(const dvec3& ray_origin, const dvec3& ray_direction, double major_radius, double minor_radius) {
     double majorR = major_radius;
     double minorR = minor_radius;
     double majorRadiusSquared = majorR * majorR;
@@ -106,7 +107,7 @@ static double compute_torus_intersection(const vec3& ray_origin, const vec3& ray
 // pos: Position on the torus (in object space)
 // major_radius: Radius from the torus center to the tube center
 // minor_radius: Radius of the tube itself
-static vec3 compute_torus_normal(const vec3& position, double major_radius, double minor_radius) {
+static dvec3 compute_torus_normal(const dvec3& position, double major_radius, double minor_radius) {
     double majorR = major_radius;
 
     double X = position[0];
@@ -116,10 +117,10 @@ static vec3 compute_torus_normal(const vec3& position, double major_radius, doub
     double distance = std::sqrt(X * X + Y * Y);
 
     if (distance < 1e-14) {
-        return unit_vector(vec3(X, Y, Z));
+        return unit_vector(dvec3(X, Y, Z));
     }
 
-    vec3 gradient(
+    dvec3 gradient(
         2.0 * (distance - majorR) * (X / distance),
         2.0 * (distance - majorR) * (Y / distance),
         2.0 * Z
@@ -169,27 +170,41 @@ public:
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        // The quartic is solved in double even when geometry is stored in
+        // float (see real.h), which would lose too many digits
+        const dvec3 axis_u(u), axis_v(v), axis_w(w);
+        const ray placed = placement.to_local(r);
+
         // Translate ray origin to the torus's local coordinate system
-        vec3 ray_origin_object_space = r.origin() - center;
-        vec3 ray_direction_object_space = r.direction();
+        dvec3 ray_origin_object_space = dvec3(placed.origin()) - dvec3(center);
+        dvec3 ray_direction_object_space(placed.direction());
+
+        // The quartic wants a unit direction, which a scaling placement does
+        // not leave; distances along it are converted back below
+        double direction_length = 1.0;
+        if (!placement.is_identity()) {
+            direction_length = ray_direction_object_space.length();
+            ray_direction_object_space /= direction_length;
+        }
 
         // Convert ray to the torus's local object space using basis vectors
-        vec3 local_origin(
-            dot(ray_origin_object_space, u),
-            dot(ray_origin_object_space, v),
-            dot(ray_origin_object_space, w)
+        dvec3 local_origin(
+            dot(ray_origin_object_space, axis_u),
+            dot(ray_origin_object_space, axis_v),
+            dot(ray_origin_object_space, axis_w)
         );
-        vec3 local_direction(
-            dot(ray_direction_object_space, u),
-            dot(ray_direction_object_space, v),
-            dot(ray_direction_object_space, w)
+        dvec3 local_direction(
+            dot(ray_direction_object_space, axis_u),
+            dot(ray_direction_object_space, axis_v),
+            dot(ray_direction_object_space, axis_w)
         );
 
         // Compute the intersection of the ray with the torus
-        double t = compute_torus_intersection(local_origin, local_direction, major_radius, minor_radius);
+        double t_local = compute_torus_intersection(local_origin, local_direction, major_radius, minor_radius);
+        double t = t_local / direction_length;
 
         // Check if there is a valid intersection within the ray's bounds
-        if (t < 0.0 || !ray_t.contains(t))
+        if (t_local < 0.0 || !ray_t.contains(t))
             return false;
 
         // Populate the hit record with intersection data
@@ -197,11 +212,12 @@ public:
         rec.p = r.at(t);
 
         // Compute the surface normal at the hit point in local space
-        vec3 hit_point_local = local_origin + t * local_direction;
-        vec3 normal_local = compute_torus_normal(hit_point_local, major_radius, minor_radius);
+        dvec3 hit_point_local = local_origin + t_local * local_direction;
+        dvec3 normal_local = compute_torus_normal(hit_point_local, major_radius, minor_radius);
 
         // Transform the normal back to world space
-        vec3 normal_world = normal_local[0] * u + normal_local[1] * v + normal_local[2] * w;
+        vec3 normal_world = placement.normal_to_world(
+            vec3(normal_local[0] * axis_u + normal_local[1] * axis_v + normal_local[2] * axis_w));
 
         rec.set_face_normal(r, normal_world);
         rec.material = &material;
@@ -210,7 +226,15 @@ public:
         return true;
     }
 
+    // The center, axis and radii take translations, rotations and uniform
+    // scale; any other transform, and every one after it, goes to the
+    // placement.
     void transform(const Matrix4x4& matrix) override {
+        if (!placement.is_identity() || !ObjectTransform::is_similarity(matrix)) {
+            placement.apply(matrix);
+            return;
+        }
+
         center = matrix.transform_point(center);
 
         u = matrix.transform_vector(u);
@@ -221,10 +245,10 @@ public:
         u = unit_vector(cross(vec3(0, 1, 0), w));
         v = cross(w, u);
 
-        // Adjust radii for uniform scaling (if applicable)
-        /*double scale_factor = matrix.get_uniform_scale();
+        // Adjust radii for uniform scaling
+        double scale_factor = matrix.get_uniform_scale();
         major_radius *= scale_factor;
-        minor_radius *= scale_factor;*/
+        minor_radius *= scale_factor;
     }
 
     BoundingBox bounding_box() const override {
@@ -233,7 +257,7 @@ public:
         point3 min_point = center - vec3(max_extent, max_extent, max_extent);
         point3 max_point = center + vec3(max_extent, max_extent, max_extent);
 
-        return BoundingBox(min_point, max_point);
+        return placement.bounds_to_world(BoundingBox(min_point, max_point));
     }
 
     std::string get_type_name() const override {
@@ -251,6 +275,7 @@ private:
     mat material;
 
     vec3 u, v, w;
+    ObjectTransform placement;
 };
 
 #endif
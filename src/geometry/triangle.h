@@ -29,6 +29,15 @@ public:
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!hit_closest(r, ray_t, rec)) {
+            return false;
+        }
+        complete_pending_hit(r, rec);
+        return true;
+    }
+
+    // Leaves the barycentric coordinates in rec.u and rec.v for complete_hit()
+    bool hit_closest(const ray& r, interval ray_t, hit_record& rec) const override {
         const double epsilon = 1e-7; // Small value to avoid division by zero
 
         // Apply bias to the ray interval to avoid precision issues
@@ -42,8 +51,13 @@ public:
         const vec3 P = cross(r.direction(), edge02);
         const double determinant = dot(edge01, P);
 
-        // If the determinant is near zero, the ray is parallel to the triangle
-        if (std::fabs(determinant) < epsilon) {
+        // If the determinant is near zero, the ray is parallel to the triangle.
+        // It scales with the direction and both edges, which are not unit
+        // length in a placed mesh's local space, so the test is relative to
+        // |d|*|e1|*|e2| (compared squared, without square roots).
+        const double scale_squared = static_cast<double>(r.direction().length_squared())
+            * edge01.length_squared() * edge02.length_squared();
+        if (determinant * determinant <= epsilon * epsilon * scale_squared) {
             return false; // No hit
         }
 
@@ -84,22 +98,27 @@ public:
             return false; // No hit
         }
 
-        // Calculate the triangle's normal
-        const vec3 normal = unit_vector(cross(edge01, edge02));
+        rec.t = t;
+        rec.u = u_bary;
+        rec.v = v_bary;
+        rec.hit_object = this;
+        rec.pending = this;
+        return true; // Hit occurred
+    }
+
+    void complete_hit(const ray& r, hit_record& rec) const override {
+        const double u_bary = rec.u;
+        const double v_bary = rec.v;
 
         // Fill the hit record with information about the intersection
-        rec.t = t;
-        rec.p = r.at(t); // Calculate the hit point
-        rec.normal = normal; // Set the surface normal
+        rec.p = r.at(rec.t); // Calculate the hit point
+        rec.normal = unit_vector(cross(v1 - v0, v2 - v0)); // Set the surface normal
         rec.material = &material; // Set the material of the triangle
-        rec.hit_object = this;
 
         // Calculate texture coordinates using barycentric coordinates
         const double w = 1.0 - u_bary - v_bary;  // Third barycentric coordinate
         rec.u = w * u0 + u_bary * u1 + v_bary * u2; // Interpolated u
         rec.v = w * v0_uv + u_bary * v1_uv + v_bary * v2_uv; // Interpolated v
-
-        return true; // Hit occurred
     }
 
     void transform(const Matrix4x4& matrix) override {
@@ -145,6 +164,10 @@ public:
         return material;
     }
 
+    const point3& get_v0() const { return v0; }
+    const point3& get_v1() const { return v1; }
+    const point3& get_v2() const { return v2; }
+
     bool is_point_inside(const point3& p) const override {
         const double epsilon = 1e-7;
         // Calculate edges
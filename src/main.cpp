@@ -4,10 +4,8 @@
 #include <cstdlib>
 
 #ifdef _WIN32
-#include <omp.h>
 #define SET_ENV(name, value) _putenv_s(name, value)
 #else
-#include <omp.h>
 #define SET_ENV(name, value) setenv(name, value, 1)
 #endif
 
@@ -26,6 +24,8 @@
 #include "wireframe.h"
 #include "camera.h"
 #include "light.h"
+#include "render_thread.h"
+#include "render_job.h"
 
 // Primitives
 #include "sphere.h"
@@ -63,8 +63,6 @@ int main(int argc, char* argv[]) {
     int window_width = 1080;
     int window_height = int(window_width / aspect_ratio);
 
-    SET_ENV("KMP_WARNINGS", "0");
-
     if (!InitializeSDL()) {
         return -1;
     }
@@ -208,6 +206,25 @@ int main(int argc, char* argv[]) {
     //Build a BVH Tree
     world.buildBVH();
 
+    // Tracing runs on its own thread; the loop below only presents finished frames
+    RenderThread render_thread(world);
+    // The UI closes the gate only around its scene edits; see interface_imgui.h
+    scene_edit_gate = &render_thread.gate();
+    uint64_t presented_frame_id = 0;
+    std::optional<ObjectID> presented_selection;
+    std::vector<Uint32> outlined_pixels;   // Presented frame with the selection drawn in
+    int texture_width = image_width;     // Allocated texture size; frames may use less of it
+    int texture_height = image_height;
+    SDL_Rect frame_rect{ 0, 0, image_width, image_height };
+    ResolutionController& resolution = render_state.resolution();
+
+    // Final renders; the one shown in the viewport is mirrored into its own texture
+    RenderJobList render_jobs;
+    const RenderJob* job_texture_owner = nullptr;
+    SDL_Texture* job_texture = nullptr;
+    FrameBuffer job_frame;
+    uint64_t job_version = 0;
+
     // FPS Counter
     float deltaTime = 0.0f;
     Uint64 currentTime = SDL_GetPerformanceCounter();
@@ -225,7 +242,8 @@ int main(int argc, char* argv[]) {
 
         while (SDL_PollEvent(&event)) {
             ImGui_ImplSDL2_ProcessEvent(&event);
-            handle_event(event, running, window, aspect_ratio, camera, render_state, world, highlighted_box, speed);
+            handle_event(event, running, window, aspect_ratio, camera, render_state, world, highlighted_box, speed,
+                &render_thread.presented_frame());
         }
 
         // Start ImGui frame
@@ -235,10 +253,13 @@ int main(int argc, char* argv[]) {
 
         draw_menu(render_state, camera, world, builder);
 
-        DrawFpsCounter(fps);
+        const FrameBuffer& shown_frame = render_thread.acquire_frame();
+        DrawFpsCounter(fps, static_cast<float>(shown_frame.render_ms), static_cast<float>(shown_frame.path_stats.average_bounces()));
 
         ShowHittableManagerUI(world, camera);
 
+        ShowRenderJobsUI(render_jobs);
+
         // Render ImGui
         ImGui::Render();
 
@@ -248,79 +269,139 @@ int main(int argc, char* argv[]) {
         RenderMode previous_mode = render_state.get_previous_mode();
 
         update_camera(camera, 0.2f);
+        resolution.update_motion(camera);
+        SDL_GetWindowSize(window, &window_width, &window_height);
+
+        // With guided upscaling the interactive output matches the window; shading
+        // still runs at a fraction of it
+        int upscale_factor = render_state.get_upscale_factor();
+        int interactive_full_width = (upscale_factor > 1) ? std::max(window_width, image_width) : image_width;
 
-        // Render raytraced scene
+        // Forward the camera to the render thread
         if (render_state.is_mode(DefaultRender)) {
             if (previous_mode != DefaultRender) {
                 render_state.set_mode(DefaultRender);
-                camera.set_image_width(image_width);
+            }
 
-                SDL_DestroyTexture(texture);
-                texture = SDL_CreateTexture(
-                    renderer,
-                    SDL_PIXELFORMAT_ARGB8888,
-                    SDL_TEXTUREACCESS_STREAMING,
-                    camera.get_image_width(),
-                    camera.get_image_height()
-                );
+            // Trace at reduced resolution while the camera moves, full resolution once it stops
+            int interactive_width = resolution.width_for(interactive_full_width);
+            if (camera.get_image_width() != interactive_width) {
+                camera.set_image_width(interactive_width);
             }
 
-            camera.render(world, samples_per_pixel, false);
+            // Keep history while still, reproject it while moving. Camera space moves the
+            // world instead of the camera, so reprojection does not apply there.
+            RenderRequest request{ camera, samples_per_pixel, false, true, "", upscale_factor };
+            request.temporal = render_state.is_temporal_enabled() && !camera.CameraSpaceStatus();
+            request.reproject = request.temporal && resolution.is_moving();
+            request.relight = render_state.is_relight_enabled();
+            request.wavefront = render_state.is_wavefront_enabled();
+            request.shadow_cache = render_state.is_shadow_cache_enabled();
+            request.raster_primary = render_state.is_raster_primary_enabled();
+            render_thread.submit(request);
+        }
+        else if (render_state.is_mode(HighResolution) || render_state.is_mode(LowResolution)) {
+            // Final frames run as background jobs on a snapshot of the scene; the
+            // previous mode (and its preview) carries on meanwhile
+            Camera job_camera = camera;
+            if (render_state.is_mode(HighResolution)) {
+                job_camera.set_image_width(1920);
+                render_jobs.start(job_camera, world, samples_per_pixel, false, false, "High-Resolution Render");
+            }
+            else {
+                // The denoiser makes 2 samples per pixel look like the undenoised 2x budget
+                job_camera.set_image_width(640);
+                bool denoise = render_state.is_denoise_enabled();
+                render_jobs.start(job_camera, world, denoise ? 2 : samples_per_pixel * 2, true, denoise, "Low-Resolution Render");
+            }
+            render_state.set_mode(previous_mode);
+        }
+        else if (render_state.is_mode(DiskRender)) {
+            Camera job_camera = camera;
+            job_camera.set_image_width(render_state.get_disk_render_width());
+            render_jobs.start_streaming(job_camera, world, samples_per_pixel, false,
+                render_state.get_disk_render_path(), render_state.is_disk_render_resume_enabled(), "Disk Render");
+            render_state.set_mode(previous_mode);
+        }
+        else {
+            render_thread.pause();
         }
-        else if (render_state.is_mode(HighResolution)) {
-            Uint64 start_time = SDL_GetPerformanceCounter();
-            camera.set_image_width(1920);
-            SDL_DestroyTexture(texture);
-            texture = SDL_CreateTexture(
-                renderer,
-                SDL_PIXELFORMAT_ARGB8888,
-                SDL_TEXTUREACCESS_STREAMING,
-                camera.get_image_width(),
-                camera.get_image_height()
-            );
-
-            camera.render(world, samples_per_pixel, false);
-            Uint64 end_time = SDL_GetPerformanceCounter();
-            double render_time = (end_time - start_time) / (double)SDL_GetPerformanceFrequency();
-
-            // Print resolution along with render time
-            std::cout << "High-Resolution Render: "
-                << camera.get_image_width() << "x" << camera.get_image_height()
-                << " | Render Time: " << render_time << " seconds" << std::endl;
 
-            render_state.set_mode(Disabled);
+        if (render_state.consume_clear_request()) {
+            render_thread.clear();
+            presented_frame_id = 0;
         }
-        else if (render_state.is_mode(LowResolution)) {
-            Uint64 start_time = SDL_GetPerformanceCounter();
-            camera.set_image_width(640);
+
+        // Present the latest completed frame. The texture only grows; smaller frames
+        // are uploaded into its top-left corner and stretched to the window.
+        const FrameBuffer& frame = render_thread.acquire_frame();
+        if (!frame.empty() && (frame.width > texture_width || frame.height > texture_height)) {
+            texture_width = std::max(texture_width, frame.width);
+            texture_height = std::max(texture_height, frame.height);
             SDL_DestroyTexture(texture);
             texture = SDL_CreateTexture(
                 renderer,
                 SDL_PIXELFORMAT_ARGB8888,
                 SDL_TEXTUREACCESS_STREAMING,
-                camera.get_image_width(),
-                camera.get_image_height()
+                texture_width,
+                texture_height
             );
+            SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
+            presented_frame_id = 0;
+        }
 
-            camera.render(world, samples_per_pixel * 2, true);
-            Uint64 end_time = SDL_GetPerformanceCounter();
-            double render_time = (end_time - start_time) / (double)SDL_GetPerformanceFrequency();
-
-            // Print resolution along with render time
-            std::cout << "Low-Resolution Render: "
-                << camera.get_image_width() << "x" << camera.get_image_height()
-                << " | Render Time: " << render_time << " seconds" << std::endl;
+        // Upload only when a new frame arrived, the selection changed (or after a
+        // clear). The selected object is outlined from the frame's ObjectIDs.
+        if (!frame.empty() && (frame.frame_id != presented_frame_id || selectedObjectID != presented_selection)) {
+            frame_rect = { 0, 0, frame.width, frame.height };
+            const Uint32* upload = frame.data();
+            if (selectedObjectID && !frame.aovs.empty()) {
+                outline_object(frame, *selectedObjectID, outlined_pixels);
+                upload = outlined_pixels.data();
+            }
+            SDL_UpdateTexture(texture, &frame_rect, upload, frame.pitch());
 
-            render_state.set_mode(Disabled);
+            if (frame.frame_id != presented_frame_id && render_state.is_mode(DefaultRender)) {
+                resolution.frame_completed(frame.render_ms, frame.width, interactive_full_width);
+            }
+            presented_frame_id = frame.frame_id;
+            presented_selection = selectedObjectID;
         }
 
-        Uint32* pixels = camera.get_pixels();
-        SDL_GetWindowSize(window, &window_width, &window_height);
+        // A shown render job replaces the preview; its finished tiles appear as they complete
+        SDL_Texture* present_texture = texture;
+        SDL_Rect present_rect = frame_rect;
+        if (render_jobs.shown) {
+            const RenderJob* job = render_jobs.shown;
+            if (job != job_texture_owner) {
+                if (job_texture) {
+                    SDL_DestroyTexture(job_texture);
+                }
+                job_texture = SDL_CreateTexture(
+                    renderer,
+                    SDL_PIXELFORMAT_ARGB8888,
+                    SDL_TEXTUREACCESS_STREAMING,
+                    job->get_width(),
+                    job->get_height()
+                );
+                SDL_SetTextureScaleMode(job_texture, SDL_ScaleModeLinear);
+                job_texture_owner = job;
+                job_version = UINT64_MAX;   // Forces the first copy
+            }
+            if (job->copy_frame(job_frame, job_version)) {
+                SDL_UpdateTexture(job_texture, nullptr, job_frame.data(), job_frame.pitch());
+            }
+            present_texture = job_texture;
+            present_rect = { 0, 0, job->get_width(), job->get_height() };
+        }
+        else if (job_texture) {
+            SDL_DestroyTexture(job_texture);
+            job_texture = nullptr;
+            job_texture_owner = nullptr;
+        }
 
-        // Calculate the destination rectangle to properly scale and center the texture
-        int texture_width = camera.get_image_width();
-        int texture_height = camera.get_image_height();
-        double texture_aspect_ratio = static_cast<double>(texture_width) / texture_height;
+        // Calculate the destination rectangle to properly scale and center the frame
+        double texture_aspect_ratio = static_cast<double>(present_rect.w) / present_rect.h;
         double window_aspect_ratio = static_cast<double>(window_width) / window_height;
 
         if (texture_aspect_ratio > window_aspect_ratio) {
@@ -337,9 +418,9 @@ int main(int argc, char* argv[]) {
             destination_rect.x = (window_width - destination_rect.w) / 2; // Center horizontally
             destination_rect.y = 0;
         }
-        SDL_UpdateTexture(texture, nullptr, pixels, camera.get_image_width() * sizeof(Uint32));
+
         SDL_RenderClear(renderer);
-        SDL_RenderCopy(renderer, texture, nullptr, &destination_rect);
+        SDL_RenderCopy(renderer, present_texture, &present_rect, &destination_rect);
 
         DrawCrosshair(renderer, window_width, window_height);
 
@@ -348,7 +429,9 @@ int main(int argc, char* argv[]) {
         }
 
         if (renderWireframe) {
-            DrawOctreeWireframe(renderer, world, camera, destination_rect, highlighted_box);
+            // Depth-tested against the preview; a shown render job may differ from it
+            DrawOctreeWireframe(renderer, world, camera, destination_rect, highlighted_box,
+                render_jobs.shown ? nullptr : &frame.aovs);
         }
 
         // Render ImGui
@@ -357,6 +440,11 @@ int main(int argc, char* argv[]) {
         SDL_RenderPresent(renderer);
     }
 
+    render_jobs.jobs.clear();
+    render_thread.stop();
+    if (job_texture) {
+        SDL_DestroyTexture(job_texture);
+    }
     // Cleanup
     ImGui_ImplSDLRenderer2_Shutdown();
     ImGui_ImplSDL2_Shutdown();
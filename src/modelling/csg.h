@@ -49,8 +49,13 @@ public:
             return false;
         }
 
-        // Delegate to the wrapped object's hit method
-        return object->hit(r, ray_t, rec);
+        // Delegate to the wrapped object's hit method, but report the wrapper,
+        // which is what the scene holds, as the object that was hit
+        if (!object->hit(r, ray_t, rec)) {
+            return false;
+        }
+        rec.hit_object = this;
+        return true;
     }
 
     // Collect all intersections for CSG logic
@@ -91,10 +96,21 @@ public:
         return object->get_material();
     }
 
+    bool is_reflective() const override {
+        return object->is_reflective();
+    }
+
     void set_material(const mat& new_material) override {
         object->set_material(new_material);
     }
 
+    // Copies the wrapper around a copy of the wrapped object
+    std::shared_ptr<hittable> clone() const override {
+        auto copy = std::make_shared<CSGPrimitive>(*this);
+        copy->object = object->clone();
+        return copy;
+    }
+
 private:
     std::shared_ptr<hittable> object;
     // Mutable members for lazy BB calculation
@@ -253,7 +269,7 @@ public:
 
         // Determine the initial inside/outside states.
         double eps = 1e-12;
-        double start_t = std::max(ray_t.min, 0.0) + eps;
+        double start_t = std::max<double>(ray_t.min, 0.0) + eps;
         point3 start_point = r.at(start_t);
         bool insideLeft = left->is_point_inside(start_point);
         bool insideRight = right->is_point_inside(start_point);
@@ -310,10 +326,22 @@ public:
         return bbox;
     }
 
+    bool is_reflective() const override {
+        return left->is_reflective() || right->is_reflective();
+    }
+
     std::string get_type_name() const override {
         return "CSGNode<" + csg_type_to_string(Operation::csg_type) + ">";
     }
 
+    // Copies the whole subtree, so the copy shares no child with this node
+    std::shared_ptr<hittable> clone() const override {
+        auto copy = std::make_shared<CSGNode>(*this);
+        copy->left = left->clone();
+        copy->right = right->clone();
+        return copy;
+    }
+
     char test_bb(const BoundingBox& bb) const override {
         // First check if the test box intersects our overall bounding box
         if (!bbox.intersects(bb)) {
@@ -24,7 +24,8 @@ public:
     Octree(const BoundingBox& bb, const OctreeNode& r) : bounding_box(bb), root(r) {}
 
     static Octree FromObject(const BoundingBox& bb, const hittable& obj, int depth_limit = 3) {
-        OctreeNode root = OctreeNode::FromObject(bb, obj, depth_limit);
+        // Only the top level is split into jobs; deeper cells are cheap
+        OctreeNode root = OctreeNode::FromObject(bb, obj, depth_limit, true);
         root.PostProcessMerge();
         return Octree(bb, root);
     }
@@ -1,6 +1,7 @@
 ﻿#include "interface_imgui.h"
 #include "plane.h"
 #include <string>
+#include <cstdio>
 
 #ifdef DIFFERENCE
 #undef DIFFERENCE
@@ -189,6 +190,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
 
             if (ImGui::Button("Reset to Default")) {
                 if (isCameraSpace) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     camera.toggleCameraSpace();
                     isCameraSpace = false;
                     world.transform(camera.camera_to_world_matrix);
@@ -201,6 +203,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
 
             ImGui::Separator();
             if (ImGui::Checkbox("Camera Space", &isCameraSpace)) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 camera.toggleCameraSpace();
                 if (camera.CameraSpaceStatus()) {
                     std::cout << "Switching to Camera Space: Applying World to Camera Transform.\n";
@@ -234,7 +237,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
             }
             if (ImGui::Button("Disable Raytracing (4)")) {
                 render_state.set_mode(Disabled);
-                camera.clear_pixels();
+                render_state.request_clear();
             }
 
             ImGui::Separator();
@@ -242,6 +245,24 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
             if (ImGui::Checkbox("Toggle Shadows", &renderShadows)) {
                 camera.toggleShadows();
             }
+            // Reflections weaker than this along a path are not traced
+            float minThroughput = static_cast<float>(camera.get_min_throughput());
+            ImGui::PushItemWidth(150);
+            if (ImGui::SliderFloat("Reflection Cutoff", &minThroughput, 0.0f, 0.1f, "%.4f", ImGuiSliderFlags_Logarithmic)) {
+                camera.set_min_throughput(minThroughput);
+            }
+            ImGui::PopItemWidth();
+            bool russianRoulette = camera.russian_roulette_enabled();
+            if (ImGui::Checkbox("Russian Roulette", &russianRoulette)) {
+                camera.set_russian_roulette(russianRoulette);
+            }
+            // 0 shades every light in range; more lights than this are sampled
+            int lightSamples = camera.get_light_samples();
+            ImGui::PushItemWidth(150);
+            if (ImGui::SliderInt("Light Samples", &lightSamples, 0, 16)) {
+                camera.set_light_samples(lightSamples);
+            }
+            ImGui::PopItemWidth();
             bool wireframe = renderWireframe;
             if (ImGui::Checkbox("Toggle Wireframe", &wireframe)) {
                 renderWireframe = wireframe;
@@ -253,6 +274,97 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
                 // World axes toggle logic
             }
 
+            bool denoise = render_state.is_denoise_enabled();
+            if (ImGui::Checkbox("Denoise Low-Res Frame (2 spp)", &denoise)) {
+                render_state.set_denoise_enabled(denoise);
+            }
+
+            ImGui::Separator();
+
+            // Streams bands straight to a PPM file, for sizes that do not fit in memory
+            ImGui::Text("Render to Disk (PPM):");
+            int diskWidth = render_state.get_disk_render_width();
+            ImGui::PushItemWidth(150);
+            if (ImGui::InputInt("Width", &diskWidth, 1024, 4096)) {
+                render_state.set_disk_render_width(diskWidth);
+            }
+            char diskPath[512];
+            snprintf(diskPath, sizeof(diskPath), "%s", render_state.get_disk_render_path().c_str());
+            if (ImGui::InputText("File", diskPath, sizeof(diskPath))) {
+                render_state.set_disk_render_path(diskPath);
+            }
+            ImGui::PopItemWidth();
+            bool resume = render_state.is_disk_render_resume_enabled();
+            if (ImGui::Checkbox("Resume Interrupted Render", &resume)) {
+                render_state.set_disk_render_resume_enabled(resume);
+            }
+            if (ImGui::Button("Start Disk Render")) {
+                render_state.set_mode(DiskRender);
+            }
+
+            ImGui::Separator();
+
+            bool guidedUpscale = render_state.get_upscale_factor() > 1;
+            if (ImGui::Checkbox("Guided Upscale (window resolution)", &guidedUpscale)) {
+                render_state.set_upscale_factor(guidedUpscale ? 2 : 1);
+            }
+            if (guidedUpscale) {
+                int upscaleFactor = render_state.get_upscale_factor();
+                ImGui::PushItemWidth(150);
+                if (ImGui::SliderInt("Shading Divisor", &upscaleFactor, 2, 4)) {
+                    render_state.set_upscale_factor(upscaleFactor);
+                }
+                ImGui::PopItemWidth();
+            }
+
+            bool temporalReuse = render_state.is_temporal_enabled();
+            if (ImGui::Checkbox("Temporal Reprojection", &temporalReuse)) {
+                render_state.set_temporal_enabled(temporalReuse);
+            }
+
+            bool relight = render_state.is_relight_enabled();
+            if (ImGui::Checkbox("Relight From Cache", &relight)) {
+                render_state.set_relight_enabled(relight);
+            }
+
+            // Only used at full resolution, without denoising
+            bool wavefront = render_state.is_wavefront_enabled();
+            if (ImGui::Checkbox("Wavefront Shading", &wavefront)) {
+                render_state.set_wavefront_enabled(wavefront);
+            }
+
+            // Maps are rebuilt in the background after object and light edits
+            bool shadowCache = render_state.is_shadow_cache_enabled();
+            if (ImGui::Checkbox("Shadow Cache", &shadowCache)) {
+                render_state.set_shadow_cache_enabled(shadowCache);
+            }
+
+            // Pixel centers only: ignored with antialiasing, upscaling and wavefront shading
+            bool rasterPrimary = render_state.is_raster_primary_enabled();
+            if (ImGui::Checkbox("Rasterized Primary Hits", &rasterPrimary)) {
+                render_state.set_raster_primary_enabled(rasterPrimary);
+            }
+
+            ResolutionController& resolution = render_state.resolution();
+            bool dynamicResolution = resolution.is_enabled();
+            if (ImGui::Checkbox("Dynamic Resolution", &dynamicResolution)) {
+                resolution.set_enabled(dynamicResolution);
+            }
+            if (dynamicResolution) {
+                float targetFps = static_cast<float>(resolution.get_target_fps());
+                ImGui::PushItemWidth(150);
+                if (ImGui::SliderFloat("Target FPS", &targetFps, 5.0f, 60.0f, "%.0f")) {
+                    resolution.set_target_fps(targetFps);
+                }
+                float minScale = static_cast<float>(resolution.get_min_scale());
+                if (ImGui::SliderFloat("Min Scale", &minScale, 0.1f, 1.0f, "%.2f")) {
+                    resolution.set_min_scale(minScale);
+                }
+                ImGui::PopItemWidth();
+                ImGui::Text("Motion scale: %.0f%%%s", resolution.get_scale() * 100.0,
+                    resolution.is_moving() ? " (moving)" : "");
+            }
+
             ImGui::End();
         }
     }
@@ -304,7 +416,10 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
                     if (!use_material) {
                         default_material = mat(color(material_color[0], material_color[1], material_color[2]));
                     }
-                    add_mesh_to_scene(obj_filepath, world, use_material ? mtl_filepath : "", default_material);
+                    // Parsed before closing the gate, which only covers adding it
+                    auto mesh = load_mesh(obj_filepath, use_material ? mtl_filepath : "", default_material);
+                    RenderGate::EditScope edit(scene_edit_gate);
+                    world.add(mesh);
                     std::cout << "Successfully imported OBJ file: " << obj_filepath << std::endl;
                     world.buildBVH();
                 }
@@ -321,6 +436,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
         ImGui::SetNextWindowPos(ImVec2(cameraWidth + renderWidth + importWidth + (buttonSpacing * 3), menuBarHeight));
         if (ImGui::Begin("SceneMenu", &sceneMenuOpen, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_AlwaysAutoResize)) {
             if (ImGui::Button("Sonic Scene")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 world.clear();
                 builder.buildSonicScene(world);
                 world.add_directional_light(vec3(-0.6, -0.38, -0.7), 0.85, color(1, 1, 1));
@@ -330,6 +446,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
                 world.buildBVH();
             }
             if (ImGui::Button("Atividade 6 Scene")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 world.clear();
                 builder.buildAtividade6Scene(world);
                 world.add_directional_light(vec3(0.38, -0.77, -0.51), 0.65, color(1, 1, 1));
@@ -339,6 +456,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
                 world.buildBVH();
             }
             if (ImGui::Button("Clear Scene")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 world.clear();
                 world.add(std::make_shared<plane>(point3(0, -0.5, 0), vec3(0, 1, 0), 
                                                   mat(new checker_texture(color(vec3(1,1,1)),
@@ -354,7 +472,7 @@ void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, S
 
 }
 
-void DrawFpsCounter(float fps) {
+void DrawFpsCounter(float fps, float render_ms, float average_bounces) {
     // Set window flags for proper anchoring
     ImGuiWindowFlags flags =
         ImGuiWindowFlags_NoDecoration |     // No titlebar, resize handles, etc.
@@ -377,11 +495,87 @@ void DrawFpsCounter(float fps) {
 
     ImGui::Begin("FPS Counter", nullptr, flags);
     ImGui::Text("FPS: %.1f", fps);
+    ImGui::Text("Trace: %.1f ms", render_ms);
+    ImGui::Text("Bounces: %.2f", average_bounces);
+    ImGui::End();
+}
+
+void ShowRenderJobsUI(RenderJobList& jobs) {
+    if (jobs.jobs.empty()) {
+        return;
+    }
+
+    ImGui::Begin("Render Jobs", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    const RenderJob* to_remove = nullptr;
+    for (const auto& entry : jobs.jobs) {
+        const RenderJob& job = *entry;
+        ImGui::PushID(&job);
+
+        ImGui::Text("%s (%dx%d)", job.get_label().c_str(), job.get_width(), job.get_height());
+        if (!job.has_preview()) {
+            ImGui::Text("Writing %s", job.get_output_path().c_str());
+        }
+
+        double progress = job.get_progress();
+        char overlay[64];
+        switch (job.get_state()) {
+        case RenderJob::State::Running: {
+            double eta = job.get_eta_seconds();
+            if (progress >= 1.0) {
+                snprintf(overlay, sizeof(overlay), "Finishing...");
+            }
+            else if (eta < 0.0) {
+                snprintf(overlay, sizeof(overlay), "%.0f%%", progress * 100.0);
+            }
+            else {
+                snprintf(overlay, sizeof(overlay), "%.0f%% - ETA %d:%02d", progress * 100.0,
+                    static_cast<int>(eta) / 60, static_cast<int>(eta) % 60);
+            }
+            break;
+        }
+        case RenderJob::State::Finished:
+            snprintf(overlay, sizeof(overlay), "Done in %.1f s", job.get_elapsed_seconds());
+            break;
+        case RenderJob::State::Cancelled:
+            snprintf(overlay, sizeof(overlay), "Cancelled at %.0f%%", progress * 100.0);
+            break;
+        case RenderJob::State::Failed:
+            snprintf(overlay, sizeof(overlay), "Failed at %.0f%%", progress * 100.0);
+            break;
+        }
+        ImGui::ProgressBar(static_cast<float>(progress), ImVec2(260, 0), overlay);
+
+        if (job.get_state() == RenderJob::State::Running) {
+            if (ImGui::Button("Cancel")) {
+                entry->cancel();
+            }
+        }
+        else if (ImGui::Button("Remove")) {
+            to_remove = &job;
+        }
+        if (job.has_preview()) {
+            ImGui::SameLine();
+            bool shown = jobs.shown == &job;
+            if (ImGui::Checkbox("Show in Viewport", &shown)) {
+                jobs.shown = shown ? &job : nullptr;
+            }
+        }
+
+        ImGui::Separator();
+        ImGui::PopID();
+    }
+
+    if (to_remove) {
+        jobs.remove(to_remove);
+    }
+
     ImGui::End();
 }
 
 // Use an optional to track selection (no selection if std::nullopt).
 std::optional<ObjectID> selectedObjectID = std::nullopt;
+RenderGate* scene_edit_gate = nullptr;
 
 void ShowHittableManagerUI(SceneManager& world, Camera& camera) {
     // Set window position to upper right corner
@@ -432,6 +626,7 @@ void ShowHittableManagerUI(SceneManager& world, Camera& camera) {
                 ImGui::OpenPopup("Cannot Delete Plane");
             }
             else {
+                RenderGate::EditScope edit(scene_edit_gate);
                 world.remove(selectedObjectID.value());
                 selectedObjectID.reset();
                 highlighted_box.reset();
@@ -502,6 +697,7 @@ void ShowLightsUI(SceneManager& world) {
             ImGui::PopID();
         }
         if (selectedLightIndex.has_value() && ImGui::Button("Remove Light")) {
+            RenderGate::EditScope edit(scene_edit_gate);
             world.remove_light(selectedLightIndex.value());
             selectedLightIndex.reset();
         }
@@ -526,15 +722,21 @@ void ShowLightsUI(SceneManager& world) {
 
                     ImGui::PushItemWidth(sliderWidth);
                     if (ImGui::SliderScalar("##X", ImGuiDataType_Double, &pos.e[0], &pos_x_min, &pos_x_max, "X: %.3f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         light->set_position(pos);
+                        world.mark_lights_changed();
                     }
                     ImGui::SameLine();
                     if (ImGui::SliderScalar("##Y", ImGuiDataType_Double, &pos.e[1], &pos_y_min, &pos_y_max, "Y: %.3f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         light->set_position(pos);
+                        world.mark_lights_changed();
                     }
                     ImGui::SameLine();
                     if (ImGui::SliderScalar("##Z", ImGuiDataType_Double, &pos.e[2], &pos_z_min, &pos_z_max, "Z: %.3f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         light->set_position(pos);
+                        world.mark_lights_changed();
                     }
                     ImGui::PopItemWidth();
                 }
@@ -542,23 +744,29 @@ void ShowLightsUI(SceneManager& world) {
                 double intensity = light->get_intensity();
                 double inten_min = 0.0, inten_max = 10.0;
                 if (ImGui::SliderScalar("Intensity", ImGuiDataType_Double, &intensity, &inten_min, &inten_max, "%.3f")) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     light->set_intensity(intensity);
+                    world.mark_lights_changed();
                 }
 
                 vec3 col = light->get_color();
                 float col_f[3] = { static_cast<float>(col.e[0]), static_cast<float>(col.e[1]), static_cast<float>(col.e[2]) };
                 if (ImGui::ColorEdit3("Color", col_f)) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     col.e[0] = static_cast<double>(col_f[0]);
                     col.e[1] = static_cast<double>(col_f[1]);
                     col.e[2] = static_cast<double>(col_f[2]);
                     light->set_color(col);
+                    world.mark_lights_changed();
                 }
 
                 if (auto dirLight = dynamic_cast<DirectionalLight*>(light.get())) {
                     vec3 dir = dirLight->get_direction();
                     double dir_min = -1.0, dir_max = 1.0;
                     if (ImGui::SliderScalarN("Direction", ImGuiDataType_Double, dir.e, 3, &dir_min, &dir_max, "%.3f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         dirLight->set_direction(dir);
+                        world.mark_lights_changed();
                     }
                 }
 
@@ -566,17 +774,23 @@ void ShowLightsUI(SceneManager& world) {
                     vec3 dir = spotLight->get_direction();
                     double dir_min = -1.0, dir_max = 1.0;
                     if (ImGui::SliderScalarN("Direction", ImGuiDataType_Double, dir.e, 3, &dir_min, &dir_max, "%.3f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         spotLight->set_direction(dir);
+                        world.mark_lights_changed();
                     }
 
                     double inner = spotLight->get_inner_cutoff();
                     double outer = spotLight->get_outer_cutoff();
                     double cutoff_min = 0.0, cutoff_max = 90.0;
                     if (ImGui::SliderScalar("Inner Cutoff", ImGuiDataType_Double, &inner, &cutoff_min, &cutoff_max, "%.1f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         spotLight->set_cutoff_angles(inner, outer);
+                        world.mark_lights_changed();
                     }
                     if (ImGui::SliderScalar("Outer Cutoff", ImGuiDataType_Double, &outer, &inner, &cutoff_max, "%.1f")) {
+                        RenderGate::EditScope edit(scene_edit_gate);
                         spotLight->set_cutoff_angles(inner, outer);
+                        world.mark_lights_changed();
                     }
                 }
             }
@@ -622,6 +836,7 @@ void ShowLightsUI(SceneManager& world) {
             }
 
             if (ImGui::Button("Add Light")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 if (light_type == 0) {
                     world.add_point_light(pos, intensity, color);
                 }
@@ -738,16 +953,35 @@ void ShowInfoTab(SceneManager& world) {
                                    static_cast<float>(diffuseColor.e[2]) };
 
                 if (ImGui::ColorEdit3("Object Color", color)) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     diffuseColor.e[0] = static_cast<double>(color[0]);
                     diffuseColor.e[1] = static_cast<double>(color[1]);
                     diffuseColor.e[2] = static_cast<double>(color[2]);
                     obj->set_material(mat(diffuseColor));
+                    world.mark_material_changed(selectedObjectID.value());
                 }
             }
             catch (const std::exception& e) {
                 std::cerr << "[ERROR] Failed to set material: " << e.what() << std::endl;
             }
 
+            // Rays that can hit the object; the others pass through it
+            uint8_t visibility = obj->get_ray_visibility();
+            bool cameraVisible = (visibility & CameraRays) != 0;
+            bool castsShadows = (visibility & ShadowRays) != 0;
+            bool reflected = (visibility & ReflectionRays) != 0;
+            bool visibilityChanged = ImGui::Checkbox("Camera Visible", &cameraVisible);
+            ImGui::SameLine();
+            visibilityChanged |= ImGui::Checkbox("Casts Shadows", &castsShadows);
+            ImGui::SameLine();
+            visibilityChanged |= ImGui::Checkbox("Reflected", &reflected);
+            if (visibilityChanged) {
+                RenderGate::EditScope edit(scene_edit_gate);
+                uint8_t mask = (cameraVisible ? CameraRays : 0) | (castsShadows ? ShadowRays : 0) | (reflected ? ReflectionRays : 0);
+                world.set_ray_visibility(selectedObjectID.value(), mask);
+                world.buildBVH(false);
+            }
+
             if (world.hasOctree(selectedObjectID.value())) {
                 ImGui::Text("Octree Generated!");
 
@@ -842,15 +1076,16 @@ void ShowGeometryTab(SceneManager& world) {
             ImGui::PopItemWidth();
 
             if (ImGui::Button("Apply Translation")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 Matrix4x4 transform = Matrix4x4::translation(vec3(translation[0], translation[1], translation[2]));
                 world.transform_object(selectedObjectID.value(), transform);
                 highlighted_box = world.get(selectedObjectID.value())->bounding_box();
                 translation[0] = translation[1] = translation[2] = 0.0f; // Reset
-                world.buildBVH();
             }
 
             ImGui::SameLine();
             if (ImGui::Button("Reset Position")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 point3 targetPosition = point3(0.0f, 0.0f, -1.0f);
                 vec3 resetTranslation = targetPosition - center;
                 Matrix4x4 resetTransform = Matrix4x4::translation(resetTranslation);
@@ -888,6 +1123,7 @@ void ShowGeometryTab(SceneManager& world) {
                 // Normalize the rotation axis to avoid scaling issues
                 vec3 rotationAxis(rotationDirection[0], rotationDirection[1], rotationDirection[2]);
                 if (rotationAxis.length_squared() > 0.0) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     rotationAxis = unit_vector(rotationAxis);
 
                     // Choose the rotation point based on the checkbox
@@ -898,7 +1134,6 @@ void ShowGeometryTab(SceneManager& world) {
                     Matrix4x4 rotationMatrix = rotationMatrix.rotateAroundPoint(rotationPoint, rotationAxis, rotationAngle);
                     world.transform_object(selectedObjectID.value(), rotationMatrix);
                     highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                    world.buildBVH();
                 }
             }
 
@@ -925,6 +1160,7 @@ void ShowGeometryTab(SceneManager& world) {
                 // Apply continuous rotation
                 vec3 rotationAxis(rotationDirection[0], rotationDirection[1], rotationDirection[2]);
                 if (rotationAxis.length_squared() > 0.0) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     rotationAxis = unit_vector(rotationAxis);
 
                     // Choose the rotation point based on the checkbox
@@ -935,7 +1171,6 @@ void ShowGeometryTab(SceneManager& world) {
                     Matrix4x4 rotationMatrix = rotationMatrix.rotateAroundPoint(rotationPoint, rotationAxis, frameRotationAngle);
                     world.transform_object(selectedObjectID.value(), rotationMatrix);
                     highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                    world.buildBVH(false);
                 }
             }
 
@@ -966,6 +1201,7 @@ void ShowGeometryTab(SceneManager& world) {
             }
 
             if (ImGui::Button("Apply Scaling")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 // Apply scaling around the object's center
                 Matrix4x4 translateToOrigin = Matrix4x4::translation(vec3(-center.x(), -center.y(), -center.z()));
                 Matrix4x4 scaleMatrix = Matrix4x4::scaling(scaleValues[0], scaleValues[1], scaleValues[2]);
@@ -983,7 +1219,6 @@ void ShowGeometryTab(SceneManager& world) {
 
                 world.transform_object(selectedObjectID.value(), finalTransform);
                 highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                world.buildBVH();
 
                 // Reset scale values for next input
                 scaleValues[0] = scaleValues[1] = scaleValues[2] = 1.0f;
@@ -993,11 +1228,11 @@ void ShowGeometryTab(SceneManager& world) {
             ImGui::SameLine();
             if (ImGui::Button("Reset Scaling")) {
                 try {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     // Apply the inverse of the accumulated scaling matrix
                     Matrix4x4 inverseScale = accumulatedScaleMatrix.inverse();
                     world.transform_object(selectedObjectID.value(), inverseScale);
                     highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                    world.buildBVH();
                 }
                 catch (const std::runtime_error& e) {
                     std::cerr << "Error resetting scale: " << e.what() << "\n"; // Error handling
@@ -1037,6 +1272,7 @@ void ShowGeometryTab(SceneManager& world) {
             ImGui::SliderFloat3("Shear Factors", shearValues, -1.0f, 1.0f);
 
             if (ImGui::Button("Apply Shear")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 point3 shearingPoint = useCustomShearPoint ?
                     point3(customShearPoint[0], customShearPoint[1], customShearPoint[2]) :
                     center;
@@ -1057,17 +1293,16 @@ void ShowGeometryTab(SceneManager& world) {
                 world.transform_object(selectedObjectID.value(), finalTransform);
                 highlighted_box = world.get(selectedObjectID.value())->bounding_box();
                 shearValues[0] = shearValues[1] = shearValues[2] = 0.0f;
-                world.buildBVH();
             }
 
             ImGui::SameLine();
             if (ImGui::Button("Reset Shear")) {
                 // Apply the inverse of the accumulated shear matrix
                 try {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     Matrix4x4 inverseShear = accumulatedShearMatrix.inverse();
                     world.transform_object(selectedObjectID.value(), inverseShear);
                     highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                    world.buildBVH();
                 }
                 catch (const std::runtime_error& e) {
                     std::cerr << "Error resetting shear: " << e.what() << "\n"; //error handling
@@ -1111,9 +1346,9 @@ void ShowGeometryTab(SceneManager& world) {
                     accumulatedShearMatrix = finalTransform * accumulatedShearMatrix;
                 }
 
+                RenderGate::EditScope edit(scene_edit_gate);
                 world.transform_object(selectedObjectID.value(), finalTransform);
                 highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                world.buildBVH(false);
             }
 
             ImGui::EndTabItem();
@@ -1154,6 +1389,7 @@ void ShowGeometryTab(SceneManager& world) {
             ImGui::PopItemWidth();
 
             if (ImGui::Button("Apply Reflection")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 // Use custom reflection point if enabled, otherwise default to the object's bounding box center
                 vec3 normal(reflectionNormal[0], reflectionNormal[1], reflectionNormal[2]);
                 point3 point = useCustomReflectionPoint ?
@@ -1162,7 +1398,6 @@ void ShowGeometryTab(SceneManager& world) {
                 Matrix4x4 transform = transform.mirror(normal, point);
                 world.transform_object(selectedObjectID.value(), transform);
                 highlighted_box = world.get(selectedObjectID.value())->bounding_box();
-                world.buildBVH();
             }
 
             ImGui::EndTabItem();
@@ -1206,6 +1441,7 @@ void ShowPrimitivesTab(SceneManager& world) {
             ImGui::ColorEdit3("Color", boxColor);
 
             if (ImGui::Button("Create Box")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 std::shared_ptr<CSGPrimitive> boxPrim;
                 if (useMinMax) {
                     boxPrim = std::make_shared<CSGPrimitive>(
@@ -1269,6 +1505,7 @@ void ShowPrimitivesTab(SceneManager& world) {
             ImGui::ColorEdit3("Color", sphereColor);
 
             if (ImGui::Button("Create Sphere")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 auto spherePrim = std::make_shared<CSGPrimitive>(
                     std::make_shared<sphere>(
                         point3(sphereCenter[0], sphereCenter[1], sphereCenter[2]),
@@ -1309,6 +1546,7 @@ void ShowPrimitivesTab(SceneManager& world) {
             ImGui::Checkbox("Capped", &capped);
 
             if (ImGui::Button("Create Cylinder")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 auto cylinderPrim = std::make_shared<CSGPrimitive>(
                     std::make_shared<cylinder>(
                         point3(baseCenter[0], baseCenter[1], baseCenter[2]),
@@ -1359,6 +1597,7 @@ void ShowPrimitivesTab(SceneManager& world) {
             ImGui::Checkbox("Capped", &capped);
 
             if (ImGui::Button("Create Cone")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 auto conePrim = std::make_shared<CSGPrimitive>(
                     std::make_shared<cone>(
                         point3(baseCenter[0], baseCenter[1], baseCenter[2]),
@@ -1404,6 +1643,7 @@ void ShowPrimitivesTab(SceneManager& world) {
             ImGui::ColorEdit3("Color", pyramidColor);
 
             if (ImGui::Button("Create Square Pyramid")) {
+                RenderGate::EditScope edit(scene_edit_gate);
                 auto pyramidPrim = std::make_shared<CSGPrimitive>(
                     std::make_shared<SquarePyramid>(
                         point3(baseCenter[0], baseCenter[1], baseCenter[2]),
@@ -1528,6 +1768,7 @@ void ShowBooleanTab(SceneManager& world) {
                     break;
                 }
                 if (csgNode) {
+                    RenderGate::EditScope edit(scene_edit_gate);
                     // Reset global selection if needed.
                     if (selectedObjectID.has_value() &&
                         (selectedObjectID.value() == leftObjectID.value() ||
@@ -8,6 +8,8 @@
 #include "camera.h"
 #include "matrix4x4.h"
 #include "render_state.h"
+#include "render_job.h"
+#include "render_gate.h"
 #include "csg.h"
 #include "scene.h"
 #include "sphere.h"
@@ -22,7 +24,10 @@
 
 void draw_menu(RenderState& render_state, Camera& camera, SceneManager& world, SceneBuilder& builder);
 
-void DrawFpsCounter(float fps);
+void DrawFpsCounter(float fps, float render_ms, float average_bounces);
+
+// Lists final render jobs with progress, ETA and controls to cancel, show or remove them.
+void ShowRenderJobsUI(RenderJobList& jobs);
 
 void ShowHittableManagerUI(SceneManager& world, Camera& camera);
 
@@ -45,4 +50,8 @@ void ShowBooleanTab(SceneManager& world);
 
 extern std::optional<ObjectID> selectedObjectID;
 
-extern std::optional<BoundingBox> highlighted_box;
\ No newline at end of file
+extern std::optional<BoundingBox> highlighted_box;
+
+// Closed around each scene edit the UI makes, so tracing only pauses for the
+// edit itself. Null when nothing renders concurrently.
+extern RenderGate* scene_edit_gate;
\ No newline at end of file
@@ -57,6 +57,10 @@ SDL_Texture* CreateTexture(SDL_Renderer* renderer, int width, int height) {
     if (!texture) {
         std::cerr << "Failed to create texture: " << SDL_GetError() << std::endl;
     }
+    else {
+        // Reduced-resolution frames are stretched to the window
+        SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
+    }
     return texture;
 }
 
@@ -145,9 +149,29 @@ void update_camera(Camera& camera, float speed) {
 }
 
 
+// Returns the object seen at the relative window position (x, y), both in
+// [0, 1]. Reads the ObjectID buffer of the presented frame when it has one;
+// otherwise casts a single ray through the scene.
+std::optional<ObjectID> pick_object(double relative_x, double relative_y, const Camera& camera,
+    const SceneManager& world, const FrameBuffer* frame) {
+    if (frame && !frame->aovs.empty()) {
+        int pixel_x = static_cast<int>(relative_x * frame->aovs.width);
+        int pixel_y = static_cast<int>(relative_y * frame->aovs.height);
+        return frame->aovs.object_at(pixel_x, pixel_y);
+    }
+
+    int pixel_x = static_cast<int>(relative_x * camera.get_image_width());
+    int pixel_y = static_cast<int>(relative_y * camera.get_image_height());
+    hit_record rec;
+    if (!world.hit(camera.primary_ray(pixel_x, pixel_y), interval(0.001, infinity), rec)) {
+        return std::nullopt;
+    }
+    return world.find_id(rec.hit_object);
+}
+
 void handle_event(const SDL_Event& event, bool& running, SDL_Window* window, double aspect_ratio,
     Camera& camera, RenderState& render_state, SceneManager& world,
-    std::optional<BoundingBox>& highlighted_box, float speed = 0.1f) {
+    std::optional<BoundingBox>& highlighted_box, float speed = 0.1f, const FrameBuffer* frame = nullptr) {
 
     if (event.type == SDL_QUIT) {
         running = false;
@@ -273,7 +297,7 @@ void handle_event(const SDL_Event& event, bool& running, SDL_Window* window, dou
 
         case SDLK_4: // Set render mode: Disabled
             render_state.set_mode(Disabled);
-            camera.clear_pixels();
+            render_state.request_clear();
             break;
 
         case SDLK_h:
@@ -385,46 +409,15 @@ void handle_event(const SDL_Event& event, bool& running, SDL_Window* window, dou
             double relative_x = static_cast<double>(mouse_x) / window_width;
             double relative_y = static_cast<double>(mouse_y) / window_height;
 
-            // Map these to the camera's resolution
-            int pixel_x = static_cast<int>(relative_x * camera.get_image_width());
-            int pixel_y = static_cast<int>(relative_y * camera.get_image_height());
-
-            // Compute the ray for the clicked position
-            ray clicked_ray = camera.compute_ray_at(pixel_x, pixel_y);
-
-            // Find the closest hit object
+            // Find the object under the cursor
             highlighted_box.reset();
-            hit_record closest_hit;
-            closest_hit.t = std::numeric_limits<double>::infinity();
-            std::shared_ptr<hittable> closest_object = nullptr;
-            ObjectID closest_id = -1;
-            auto objects = world.getObjects();
-
-            for (const auto& object : objects) {
-                const BoundingBox& box = object->bounding_box();
-                interval hit_range(0.0, closest_hit.t);
-
-                // First pass: Check bounding box
-                if (box.hit(clicked_ray, hit_range)) {
-                    // Second pass: Check actual object intersection
-                    hit_record temp_record;
-                    if (object->hit(clicked_ray, interval(0.0, closest_hit.t), temp_record)) {
-                        if (temp_record.t < closest_hit.t) {
-                            closest_hit = temp_record;
-                            closest_object = object;
-                        }
-                    }
-                }
-            }
+            std::optional<ObjectID> object_id = pick_object(relative_x, relative_y, camera, world, frame);
+            std::shared_ptr<hittable> closest_object = object_id ? world.get(*object_id) : nullptr;
 
             // If a valid object is found, highlight its bounding box and auto-select in ImGui
             if (closest_object) {
                 highlighted_box = closest_object->bounding_box();
-                // Get the ObjectID from the object
-                std::optional<ObjectID> object_id = world.get_object_id(closest_object);
-                if (object_id.has_value()) {
-                    selectedObjectID = object_id.value();
-                }
+                selectedObjectID = object_id.value();
 
                 // If this was a double click, set the camera look-at point to the object's center
                 if (is_double_click) {
@@ -7,7 +7,8 @@
 #include <memory>
 #include <algorithm>
 #include <stdexcept>
-#include <omp.h>
+
+#include "task_pool.h"
 
 constexpr size_t LEAF_SIZE_THRESHOLD = 4;
 
@@ -19,33 +20,25 @@ private:
     BoundingBox box;
     bool is_leaf;
 
-    // Determine optimal split axis using parallel reduction
-    static size_t determineSplitAxis(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end) {
-        std::vector<double> max_dims(3, 0.0);
-
-#pragma omp parallel
-        {
-            std::vector<double> local_max_dims(3, 0.0);
+    // Subtrees with more objects than this are built as separate pool tasks
+    static constexpr size_t PARALLEL_BUILD_THRESHOLD = 1000;
 
-#pragma omp for nowait
-            for (long long i = start; i < static_cast<long long>(end); ++i) {
-                auto dimensions = objects[i]->bounding_box().getDimensions();
-                for (int j = 0; j < 3; ++j) {
-                    local_max_dims[j] = std::max(local_max_dims[j], dimensions[j]);
-                }
-            }
+    // Determine the split axis as the largest object extent in the range
+    static size_t determineSplitAxis(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end) {
+        double max_dims[3] = { 0.0, 0.0, 0.0 };
 
-#pragma omp critical
+        for (size_t i = start; i < end; ++i) {
+            auto dimensions = objects[i]->bounding_box().getDimensions();
             for (int j = 0; j < 3; ++j) {
-                max_dims[j] = std::max(max_dims[j], local_max_dims[j]);
+                max_dims[j] = std::max<double>(max_dims[j], dimensions[j]);
             }
         }
 
-        return std::max_element(max_dims.begin(), max_dims.end()) - max_dims.begin();
+        return std::max_element(max_dims, max_dims + 3) - max_dims;
     }
 
-    // Build a subtree with OpenMP parallelization
-    static std::shared_ptr<BVHNode> buildSubtree(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end, int depth = 0) {
+    // Build a subtree; large halves are built in parallel on the shared TaskPool
+    static std::shared_ptr<BVHNode> buildSubtree(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end) {
         auto node = std::make_shared<BVHNode>();
 
         // Create a leaf node if number of objects is below threshold
@@ -61,44 +54,52 @@ private:
         auto comparator = [axis](const std::shared_ptr<hittable>& a, const std::shared_ptr<hittable>& b) {
             return a->bounding_box().getCenter()[axis] < b->bounding_box().getCenter()[axis];
             };
-
-        // Parallel sort for large enough chunks
-        if (end - start > 1000) {
-#pragma omp parallel
-            {
-#pragma omp single
-                std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end, comparator);
-            }
+        std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end, comparator);
+
+        // The halves touch disjoint ranges of 'objects'
+        if (end - start > PARALLEL_BUILD_THRESHOLD) {
+            TaskGroup subtrees(TaskLane::Background);
+            subtrees.run([&] { node->left = buildSubtree(objects, start, mid); });
+            subtrees.run([&] { node->right = buildSubtree(objects, mid, end); });
+            subtrees.wait();
         }
         else {
-            std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end, comparator);
+            node->left = buildSubtree(objects, start, mid);
+            node->right = buildSubtree(objects, mid, end);
         }
 
-        // Dynamic parallel task creation based on available resources
-#pragma omp parallel sections if(depth < omp_get_max_threads() && (end - start) > 1000)
-        {
-#pragma omp section
-            {
-                node->left = buildSubtree(objects, start, mid, depth + 1);
-            }
+        node->is_leaf = false;
+        node->box = node->left->bounding_box().enclose(node->right->bounding_box());
+        node->ray_visibility = node->left->get_ray_visibility() | node->right->get_ray_visibility();
+        return node;
+    }
+
+    // Levels of the tree whose two subtrees are refitted as separate pool tasks
+    static constexpr int PARALLEL_REFIT_DEPTH = 4;
 
-#pragma omp section
-            {
-                node->right = buildSubtree(objects, mid, end, depth + 1);
+    void refitSubtree(int depth) {
+        if (is_leaf) {
+            box = leaf_objects[0]->bounding_box();
+            for (size_t i = 1; i < leaf_objects.size(); ++i) {
+                box = box.enclose(leaf_objects[i]->bounding_box());
             }
+            return;
         }
 
-        // Sequential fallback if parallel sections weren't used
-        if (!node->left) {
-            node->left = buildSubtree(objects, start, mid, depth + 1);
+        // Children of internal nodes are always BVHNodes
+        auto* left_node = static_cast<BVHNode*>(left.get());
+        auto* right_node = static_cast<BVHNode*>(right.get());
+        if (depth < PARALLEL_REFIT_DEPTH) {
+            TaskGroup subtrees(TaskLane::Background);
+            subtrees.run([&] { left_node->refitSubtree(depth + 1); });
+            subtrees.run([&] { right_node->refitSubtree(depth + 1); });
+            subtrees.wait();
         }
-        if (!node->right) {
-            node->right = buildSubtree(objects, mid, end, depth + 1);
+        else {
+            left_node->refitSubtree(depth + 1);
+            right_node->refitSubtree(depth + 1);
         }
-
-        node->is_leaf = false;
-        node->box = node->left->bounding_box().enclose(node->right->bounding_box());
-        return node;
+        box = left->bounding_box().enclose(right->bounding_box());
     }
 
     void buildLeafNode(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end) {
@@ -110,10 +111,12 @@ private:
             leaf_objects.push_back(objects[i]);
         }
 
-        // Compute bounding box for all objects
+        // Compute bounding box and ray visibility for all objects
         box = leaf_objects[0]->bounding_box();
+        ray_visibility = leaf_objects[0]->get_ray_visibility();
         for (size_t i = 1; i < leaf_objects.size(); ++i) {
             box = box.enclose(leaf_objects[i]->bounding_box());
+            ray_visibility |= leaf_objects[i]->get_ray_visibility();
         }
 
         left = right = nullptr;  // Leaf nodes don't have children
@@ -126,29 +129,30 @@ public:
     BVHNode() : is_leaf(false) {}
 
     BVHNode(std::vector<std::shared_ptr<hittable>>& objects, size_t start, size_t end) : is_leaf(false) {
-        // Set optimal number of threads based on hardware
-        int num_threads = omp_get_max_threads();
-        omp_set_dynamic(1);  // Enable dynamic adjustment of threads
-
-        // Initialize parallel environment
-#pragma omp parallel num_threads(num_threads)
-        {
-#pragma omp single
-            {
-                auto root = buildSubtree(objects, start, end);
-                left = root->left;
-                right = root->right;
-                box = root->box;
-                is_leaf = root->is_leaf;
-                leaf_objects = root->leaf_objects;
-            }
-        }
+        auto root = buildSubtree(objects, start, end);
+        left = root->left;
+        right = root->right;
+        box = root->box;
+        ray_visibility = root->ray_visibility;
+        is_leaf = root->is_leaf;
+        leaf_objects = root->leaf_objects;
     }
 
     virtual ~BVHNode() = default;
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        if (!box.hit(r, ray_t)) {
+        if (!hit_closest(r, ray_t, rec)) {
+            return false;
+        }
+        complete_pending_hit(r, rec);
+        return true;
+    }
+
+    // Candidates only report their distance; the attributes of the closest
+    // hit are left pending. Subtrees without an object visible to the kind of
+    // 'r' are skipped.
+    bool hit_closest(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!is_visible_to(r) || !box.hit(r, ray_t)) {
             return false;
         }
 
@@ -158,7 +162,7 @@ public:
 
             // Check all objects in leaf node
             for (const auto& object : leaf_objects) {
-                if (object->hit(r, closest_so_far, rec)) {
+                if (object->is_visible_to(r) && object->hit_closest(r, closest_so_far, rec)) {
                     hit_anything = true;
                     closest_so_far.max = rec.t;
                 }
@@ -168,9 +172,9 @@ public:
         }
 
         // Internal node traversal
-        bool hit_left = left && left->hit(r, ray_t, rec);
+        bool hit_left = left && left->hit_closest(r, ray_t, rec);
         interval right_t(ray_t.min, hit_left ? rec.t : ray_t.max);
-        bool hit_right = right && right->hit(r, right_t, rec);
+        bool hit_right = right && right->hit_closest(r, right_t, rec);
 
         return hit_left || hit_right;
     }
@@ -179,6 +183,61 @@ public:
         return box;
     }
 
+    // Recomputes the boxes bottom-up after the objects moved, keeping the
+    // tree's shape. Far cheaper than a rebuild and as good when the objects
+    // moved together, as a transformed mesh's triangles do.
+    void refit() {
+        refitSubtree(0);
+    }
+
+    // Subtrees that rays of 'kind' confined to some convex volume can hit,
+    // written to 'subtrees' in no particular order. 'excludes(box)' tells
+    // whether the volume misses a box. Starting from this node, nodes it
+    // misses are dropped and the others are replaced by their children until
+    // only leaves are left or the next split would exceed 'max_count'.
+    template <typename Excludes>
+    void collect_subtrees(Excludes&& excludes, uint8_t kind, size_t max_count, std::vector<const BVHNode*>& subtrees) const {
+        subtrees.clear();
+        auto reachable = [&](const BVHNode* node) {
+            return (node->ray_visibility & kind) != 0 && !excludes(node->box);
+        };
+        if (!reachable(this)) {
+            return;
+        }
+        subtrees.push_back(this);
+        size_t i = 0;
+        while (i < subtrees.size()) {
+            const BVHNode* node = subtrees[i];
+            if (node->is_leaf) {
+                ++i;
+                continue;
+            }
+            // Children of internal nodes are always BVHNodes
+            const BVHNode* children[2] = { static_cast<const BVHNode*>(node->left.get()), static_cast<const BVHNode*>(node->right.get()) };
+            const BVHNode* kept[2];
+            size_t count = 0;
+            for (const BVHNode* child : children) {
+                if (child && reachable(child)) {
+                    kept[count++] = child;
+                }
+            }
+            if (count == 0) {
+                subtrees[i] = subtrees.back();
+                subtrees.pop_back();
+            }
+            else if (count == 1) {
+                subtrees[i] = kept[0];
+            }
+            else if (subtrees.size() < max_count) {
+                subtrees[i] = kept[0];
+                subtrees.push_back(kept[1]);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+
     bool is_point_inside(const point3& p) const override {
         // Check if the point is inside the BVH node's bounding box first (early exit)
         if (!box.contains(p)) {
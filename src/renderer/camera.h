@@ -5,12 +5,23 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
-#include <omp.h>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <type_traits>
 
 #include "raytracer.h"
 #include "light.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "hit_cache.h"
+#include "primary_raster.h"
+#include "render_gate.h"
+#include "screen_region.h"
+#include "shadow_cache.h"
+#include "task_pool.h"
+#include "tile_frustum.h"
+#include "tile_scheduler.h"
 
 class Camera {
 public:
@@ -18,29 +29,31 @@ public:
     Matrix4x4 camera_to_world_matrix;
     using ProjectionFunction = ray(Camera::*)(int, int, double, double) const;
 
+    enum class Projection { Perspective, Orthographic };
+
+    // Renders one tile; one instantiation per combination of projection,
+    // camera space, antialiasing and shadows.
+    using TileKernel = PathStats (Camera::*)(const SceneManager&, const Tile&, Uint32*, int,
+        GBuffer*, std::vector<color>*, int, HitCache*) const;
+
+    // Rays traced per path: the primary ray and up to four reflections
+    static constexpr int max_depth = 5;
+
+    // Default for set_min_throughput(): one 8-bit step of a unit radiance
+    static constexpr double default_min_throughput = 1.0 / 255.0;
+
+    // BVH subtrees a tile's camera rays start from at most (see render_tile_kernel())
+    static constexpr size_t max_tile_subtrees = 16;
+
     Camera(const point3& origin, const point3& at, int image_width, double aspect_ratio, double fov)
         : origin(origin), look_at(at), world_up(0, 1, 0), image_width(image_width), aspect_ratio(aspect_ratio), fov(fov), current_projection(&Camera::compute_ray_at)
     {
         // Compute image height
         image_height = static_cast<int>(image_width / aspect_ratio);
 
-        // Allocate pixel buffer
-        pixels = new Uint32[image_width * image_height];
-
         // Compute the transformation matrix
         calculate_axes();
         calculate_matrices();
-
-        // Clear pixels initially
-        clear_pixels();
-    }
-
-    ~Camera() {
-        delete[] pixels;
-    }
-
-    void clear_pixels() {
-        std::fill(pixels, pixels + (image_width * image_height), 0);
     }
 
     void calculate_axes() {
@@ -107,67 +120,310 @@ public:
         calculate_matrices();
     }
 
+    // Traces the scene into 'target', resizing it to the camera resolution.
+    // When a gate is given, each tile is bracketed by it so the UI thread can
+    // safely edit the scene between tiles. When 'guides' is given, the primary
+    // hit of the first sample of every pixel is recorded there as well; when
+    // 'radiance' is given, it receives the unclamped pixel colors. Passing the
+    // same scheduler on every frame lets it balance tiles by their last cost.
+    // With a region, only the tiles touching it are traced and the rest of
+    // 'target' (and of the guides) is left as it was. When 'hits' is given, the
+    // primary hit of the first sample is kept there for relight(). The tile
+    // kernel for the projection, shadow, antialiasing and camera-space settings
+    // is chosen once per frame (see select_kernel()). The rays traced are
+    // counted in target.path_stats.
     void render(
-        SceneManager& manager,
+        const SceneManager& manager,
+        FrameBuffer& target,
         int samples_per_pixel = 1,
-        bool enable_antialias = false
+        bool enable_antialias = false,
+        RenderGate* gate = nullptr,
+        GBuffer* guides = nullptr,
+        std::vector<color>* radiance = nullptr,
+        TileScheduler* scheduler = nullptr,
+        const ScreenRegion* region = nullptr,
+        HitCache* hits = nullptr
     ) const {
-        int TILESIZE = std::min(32, image_width / 10);
+        target.resize(image_width, image_height);
+        Uint32* pixels = target.data();
+        if (guides) {
+            guides->resize(image_width, image_height);
+        }
+        if (hits) {
+            hits->resize(image_width, image_height);
+        }
+        if (radiance) {
+            radiance->resize(static_cast<size_t>(image_width) * image_height);
+        }
 
-        // Compute the number of tiles in each dimension
-        const int num_x_tiles = (image_width + TILESIZE - 1) / TILESIZE;
-        const int num_y_tiles = (image_height + TILESIZE - 1) / TILESIZE;
+        TileScheduler frame_scheduler;
+        if (!scheduler) {
+            scheduler = &frame_scheduler;
+        }
 
-        // Precompute perspective parameters
-        double fov_radians = degrees_to_radians(fov);
-        double half_fov = 0.5 * fov_radians;
-        double tan_half_fov = std::tan(half_fov);
-        double screen_z = -1.0;
+        const TileKernel kernel = select_kernel(enable_antialias);
+        PathStats frame_stats;
+        std::mutex stats_mutex;
+        scheduler->run(image_width, image_height, get_tile_size(), [&](const Tile& tile) {
+            RenderGate::TileScope tile_scope(gate);
+            PathStats tile_stats = (this->*kernel)(manager, tile, pixels, samples_per_pixel, guides, radiance, 0, hits);
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            frame_stats += tile_stats;
+        }, region);
+        target.path_stats = frame_stats;
+    }
 
-#pragma omp parallel for schedule(dynamic)
-        for (int tile_index = 0; tile_index < num_x_tiles * num_y_tiles; ++tile_index) {
-            const int tile_x = (tile_index % num_x_tiles) * TILESIZE;
-            const int tile_y = (tile_index / num_x_tiles) * TILESIZE;
+    // Shades 'target' again from the primary hits a render() of this view kept
+    // in 'hits', tracing only shadow and reflection rays. Exact as long as only
+    // lights and materials changed since, and that render had no antialiasing.
+    // 'scheduler' and 'region' as in render().
+    void relight(
+        const SceneManager& manager,
+        FrameBuffer& target,
+        const HitCache& hits,
+        RenderGate* gate = nullptr,
+        TileScheduler* scheduler = nullptr,
+        const ScreenRegion* region = nullptr
+    ) const {
+        target.resize(image_width, image_height);
+        Uint32* pixels = target.data();
 
-            for (int j = 0; j < TILESIZE; ++j) {
-                for (int i = 0; i < TILESIZE; ++i) {
-                    int pixel_x = tile_x + i;
-                    int pixel_y = tile_y + j;
+        TileScheduler frame_scheduler;
+        if (!scheduler) {
+            scheduler = &frame_scheduler;
+        }
 
-                    if (pixel_x >= image_width || pixel_y >= image_height)
-                        continue;
+        const auto relight_tile = renderShadows ? &Camera::relight_tile<true> : &Camera::relight_tile<false>;
+        PathStats frame_stats;
+        std::mutex stats_mutex;
+        scheduler->run(image_width, image_height, get_tile_size(), [&](const Tile& tile) {
+            RenderGate::TileScope tile_scope(gate);
+            PathStats tile_stats = (this->*relight_tile)(manager, hits, tile, pixels);
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            frame_stats += tile_stats;
+        }, region);
+        target.path_stats = frame_stats;
+    }
 
-                    color accumulated_color(0, 0, 0);
-                    int spp = enable_antialias ? samples_per_pixel : 1;
+    // Edge length of the tiles render() hands out.
+    int get_tile_size() const {
+        return std::min(32, image_width / 10);
+    }
 
-                    for (int s = 0; s < spp; s++) {
-                        double offset_x = enable_antialias ? random_double(0.0, 1.0) : 0.5;
-                        double offset_y = enable_antialias ? random_double(0.0, 1.0) : 0.5;
+    // Traces the pixels of one tile into 'pixels', rows of the camera width
+    // starting at image row 'first_row' (0 for a full frame); 'guides',
+    // 'radiance' and 'hits' as in render(), already sized to the full frame.
+    // Returns the rays traced.
+    PathStats render_tile(
+        const SceneManager& manager,
+        const Tile& tile,
+        Uint32* pixels,
+        int samples_per_pixel,
+        bool enable_antialias,
+        GBuffer* guides = nullptr,
+        std::vector<color>* radiance = nullptr,
+        int first_row = 0,
+        HitCache* hits = nullptr
+    ) const {
+        return (this->*select_kernel(enable_antialias))(manager, tile, pixels, samples_per_pixel, guides, radiance, first_row, hits);
+    }
 
-                        // Use the projection_function_ptr to compute the ray
-                        ray r = (this->*current_projection)(pixel_x, pixel_y, offset_x, offset_y);
+    // Reflection paths end once the reflectance left along them falls below
+    // 'throughput'; 0 always follows them to max_depth.
+    void set_min_throughput(double throughput) {
+        min_throughput = std::clamp(throughput, 0.0, 1.0);
+    }
 
-                        // Cast ray and accumulate color.  Get lights from manager.
-                        accumulated_color += shade_ray_at_hit(r, manager, 5, renderShadows);
-                    }
+    // With Russian roulette, paths below the minimum throughput continue at
+    // random instead of ending, weighted so the image stays unbiased at the
+    // cost of noise.
+    void set_russian_roulette(bool enabled) {
+        russian_roulette = enabled;
+    }
+
+    double get_min_throughput() const { return min_throughput; }
+    bool russian_roulette_enabled() const { return russian_roulette; }
 
-                    // Average color and write to pixel buffer
-                    accumulated_color *= (1.0 / spp);
-                    int flipped_pixel_y = image_height - 1 - pixel_y;
-                    write_color(pixels, pixel_x, flipped_pixel_y, image_width, image_height, accumulated_color);
+    // With more point and spot lights than 'count' reaching a shading point,
+    // shades that many drawn from the scene's LightTree by importance instead
+    // of all of them. Noisier, but the cost no longer grows with the light
+    // count. 0 always shades every light in range.
+    void set_light_samples(int count) {
+        light_samples = std::max(count, 0);
+    }
+
+    int get_light_samples() const { return light_samples; }
+
+    // Answers shadow tests from 'cache' where its maps can tell, tracing rays
+    // only for the rest. The cache must outlive every frame rendered with it;
+    // null traces every shadow ray.
+    void set_shadow_cache(const ShadowCache* cache) {
+        shadow_cache = cache;
+    }
+
+    // Takes the primary hits of frames without antialiasing from 'raster'
+    // while it is current for the scene and this view, ray casting only the
+    // objects it does not rasterize. The raster must outlive every frame
+    // rendered with it; null casts every camera ray.
+    void set_primary_raster(const PrimaryRaster* raster) {
+        primary_raster = raster;
+    }
+
+    // The projection PrimaryRaster::rasterize() needs to match the camera rays
+    PrimaryRaster::View raster_view() const {
+        PrimaryRaster::View view;
+        if (isCameraSpace && !is_orthographic()) {
+            // The world is already in camera space
+            view.origin = point3(0, 0, 0);
+            view.right = vec3(1, 0, 0);
+            view.up = vec3(0, 1, 0);
+            view.forward = vec3(0, 0, 1);
+        }
+        else {
+            view.origin = origin;
+            view.right = right;
+            view.up = up;
+            view.forward = forward;
+        }
+        view.width = image_width;
+        view.height = image_height;
+        view.aspect_ratio = aspect_ratio;
+        view.tan_half_fov = std::tan(0.5 * degrees_to_radians(fov));
+        view.ortho_scale = ortho_scale;
+        view.orthographic = is_orthographic();
+        return view;
+    }
+
+
+    // Records only the primary hit of each pixel center, without shading. With
+    // a region, other pixels keep their previous guides.
+    void render_guides(const SceneManager& manager, GBuffer& guides, RenderGate* gate = nullptr, const ScreenRegion* region = nullptr) const {
+        guides.resize(image_width, image_height);
+        const ScreenRegion all = ScreenRegion::full();
+        if (!region) {
+            region = &all;
+        }
+
+        TaskPool::shared().parallel_for(0, image_height, [&](int pixel_y) {
+            RenderGate::TileScope row_scope(gate);
+
+            std::vector<std::pair<int, int>> spans;
+            region->row_spans(pixel_y, image_width, image_height, 1, spans);
+            for (const auto& [first, last] : spans) {
+                for (int pixel_x = first; pixel_x < last; ++pixel_x) {
+                    ray r = (this->*current_projection)(pixel_x, pixel_y, 0.5, 0.5);
+                    hit_record rec;
+                    bool hit = manager.hit(r, interval(0.001, infinity), rec);
+                    store_guide(manager, guides, pixel_x, pixel_y, hit ? &rec : nullptr);
                 }
             }
+        });
+    }
+
+    // Records the primary hit 'rec' of pixel (x, y) in 'guides', with its
+    // surface color and ObjectID; 'rec' is null when the ray missed.
+    static void store_guide(const SceneManager& manager, GBuffer& guides, int x, int y, const hit_record* rec) {
+        if (!rec) {
+            guides.store(x, y, nullptr);
+            return;
         }
+        guides.store(x, y, rec, rec->material->get_color(rec->u, rec->v),
+            manager.find_id(rec->hit_object).value_or(GBufferSample::no_object));
+    }
+
+    // Distance from the eye to 'p' along the camera ray through it, in the
+    // units of GBufferSample::depth.
+    double ray_distance(const point3& p) const {
+        return is_orthographic() ? view_depth(p) : (p - origin).length();
     }
 
+    // Shades the center ray of a single pixel.
+    color shade_pixel(const SceneManager& manager, int pixel_x, int pixel_y) const {
+        ray r = (this->*current_projection)(pixel_x, pixel_y, 0.5, 0.5);
+        PathStats stats;
+        return renderShadows ? trace_path<true>(r, nullptr, manager, stats) : trace_path<false>(r, nullptr, manager, stats);
+    }
+
+    // Ray through a point of a pixel (its center by default) with the active
+    // projection.
+    ray primary_ray(int pixel_x, int pixel_y, double offset_x = 0.5, double offset_y = 0.5) const {
+        return (this->*current_projection)(pixel_x, pixel_y, offset_x, offset_y);
+    }
+
+    // Shades a primary ray from its known hit, or the background when 'rec' is null.
+    color shade_primary(const SceneManager& manager, const ray& r, const hit_record* rec) const {
+        if (!rec) {
+            return background_color(r);
+        }
+        PathStats stats;
+        return renderShadows ? trace_path<true>(r, rec, manager, stats) : trace_path<false>(r, rec, manager, stats);
+    }
+
+    // Distance of 'p' in front of the eye along the view direction; negative
+    // behind it.
+    double view_depth(const point3& p) const {
+        return -dot(p - origin, forward);
+    }
+
+    bool is_orthographic() const {
+        return current_projection == &Camera::compute_orthographic_ray;
+    }
+
+    // True if both cameras produce the same image of the same scene: same
+    // viewpoint, projection, resolution, background, shadow setting and path
+    // termination.
+    bool same_view(const Camera& other) const {
+        return origin == other.origin && look_at == other.look_at &&
+            up == other.up && right == other.right && forward == other.forward &&
+            fov == other.fov && ortho_scale == other.ortho_scale &&
+            image_width == other.image_width && image_height == other.image_height &&
+            current_projection == other.current_projection &&
+            isCameraSpace == other.isCameraSpace && renderShadows == other.renderShadows &&
+            min_throughput == other.min_throughput && russian_roulette == other.russian_roulette &&
+            light_samples == other.light_samples &&
+            bg_top == other.bg_top && bg_horizon == other.bg_horizon;
+    }
+
+    // Inverse of the active projection: maps a world-space point to continuous
+    // pixel coordinates (pixel (i, j) spans [i, i+1) x [j, j+1)). Returns false
+    // for points behind a perspective camera.
+    bool project_to_pixel(const point3& p, double& pixel_x, double& pixel_y) const {
+        vec3 offset = p - origin;
+        double camera_x = dot(offset, right);
+        double camera_y = dot(offset, up);
+        double camera_z = dot(offset, forward);   // Negative in front of the camera
+
+        double screen_x, screen_y;
+        if (current_projection == &Camera::compute_orthographic_ray) {
+            screen_x = camera_x / (aspect_ratio * ortho_scale);
+            screen_y = camera_y / ortho_scale;
+        }
+        else {
+            if (camera_z >= 0.0) {
+                return false;
+            }
+            double tan_half_fov = std::tan(0.5 * degrees_to_radians(fov));
+            screen_x = camera_x / (-camera_z * aspect_ratio * tan_half_fov);
+            screen_y = camera_y / (-camera_z * tan_half_fov);
+        }
+
+        pixel_x = (screen_x + 1.0) * 0.5 * image_width;
+        pixel_y = (1.0 - screen_y) * 0.5 * image_height;
+        return true;
+    }
 
     // compute perspective ray
     ray compute_ray_at(int pixel_x, int pixel_y, double offset_x = 0.5, double offset_y = 0.5) const {
-        // Precompute perspective parameters
-        double fov_radians = degrees_to_radians(fov);
-        double half_fov = 0.5 * fov_radians;
-        double tan_half_fov = std::tan(half_fov);
+        double tan_half_fov = std::tan(0.5 * degrees_to_radians(fov));
+        return isCameraSpace
+            ? perspective_ray<true>(pixel_x, pixel_y, offset_x, offset_y, tan_half_fov)
+            : perspective_ray<false>(pixel_x, pixel_y, offset_x, offset_y, tan_half_fov);
+    }
 
+    // Perspective ray with the field of view already evaluated, for camera
+    // space (eye at the origin looking down -Z) or world space.
+    template <bool camera_space>
+    ray perspective_ray(int pixel_x, int pixel_y, double offset_x, double offset_y, double tan_half_fov) const {
         // Convert the pixel coordinate to normalized device coordinates (NDC)
         double ndc_x = (static_cast<double>(pixel_x) + offset_x) / image_width;
         double ndc_y = (static_cast<double>(pixel_y) + offset_y) / image_height;
@@ -179,7 +435,7 @@ public:
 
         vec3 ray_origin, ray_direction;
 
-        if (isCameraSpace) {
+        if constexpr (camera_space) {
             ray_origin = vec3(0.0, 0.0, 0.0);
             ray_direction = unit_vector(vec3(screen_x, screen_y, screen_z));
         }
@@ -193,7 +449,7 @@ public:
             ray_origin = origin_world.to_vec3();
         }
 
-        return ray(ray_origin, ray_direction);
+        return ray(ray_origin, ray_direction, CameraRays);
     }
 
     ray compute_orthographic_ray(int pixel_x, int pixel_y, double offset_x, double offset_y) const {
@@ -206,7 +462,7 @@ public:
         vec3 ray_origin = origin + (screen_x * right) + (screen_y * up);
         vec3 ray_direction = -forward;
 
-        return ray(ray_origin, ray_direction);
+        return ray(ray_origin, ray_direction, CameraRays);
     }
 
     void rotate_to_isometric_view() {
@@ -264,11 +520,6 @@ public:
         image_height = static_cast<int>(image_width / aspect_ratio);
         image_height = (image_height < 1) ? 1 : image_height;
 
-        // Reallocate pixel buffer
-        delete[] pixels;
-        pixels = new Uint32[image_width * image_height];
-
-        clear_pixels();
         calculate_axes();
         calculate_matrices();
     }
@@ -315,7 +566,6 @@ public:
     int get_image_width() const { return image_width; }
     int get_image_height() const { return image_height; }
     double get_ortho_scale() const { return ortho_scale; }
-    Uint32* get_pixels() const { return pixels; }
     vec3 get_right() const { return right; }
     vec3 get_up() const { return up; }
     vec3 get_forward() const { return forward; }
@@ -324,192 +574,437 @@ public:
     bool shadowStatus() const { return renderShadows; }
     bool CameraSpaceStatus() const { return isCameraSpace; }
 
-private:
-
     color background_color(const ray& r) const {
         vec3 unit_direction = unit_vector(r.direction());
         auto t = 0.5 * (unit_direction.y() + 1.0);
         return (1.0 - t) * bg_horizon + t * bg_top;
     }
 
+    // Pieces of the Phong model, for renderers that split shading into stages.
+    static color ambient_light(const color& diffuse_color) {
+        double ambient_light_intensity = 0.4;
+        color ambient_light_color(1.0, 0.95, 0.8);  // Warm yellow
+        return ambient_light_intensity * ambient_light_color * diffuse_color;
+    }
+
+    // Diffuse and specular light of 'light' at 'rec', arriving along
+    // 'light_dir' and scaled by 'attenuation', without the shadow test.
+    static color direct_light(const hit_record& rec, const vec3& view_dir, const color& diffuse_color,
+        const Light& light, const vec3& light_dir, double attenuation)
+    {
+        return calculate_diffuse(rec.normal, light_dir, diffuse_color, rec.material->k_diffuse,
+                light.get_color(), light.get_intensity()) * attenuation +
+            calculate_specular(rec.normal, light_dir, view_dir, rec.material->shininess, rec.material->k_specular,
+                light.get_color(), light.get_intensity()) * attenuation;
+    }
+
+    // Ray from 'rec' towards a light along 'light_dir'; the light is hidden if
+    // it hits anything closer than shadow_distance().
+    static ray shadow_ray(const hit_record& rec, const vec3& light_dir) {
+        const double shadow_bias = 1e-3;
+        return ray(rec.p + rec.normal * shadow_bias, light_dir, ShadowRays);
+    }
+
+    static double shadow_distance(const Light& light, const point3& p) {
+        return (dynamic_cast<const DirectionalLight*>(&light) != nullptr) ?
+            infinity : (light.get_position() - p).length();
+    }
+
+    // Visibility of 'light' from 'rec' according to the shadow cache, Unknown
+    // when there is none or it cannot tell.
+    ShadowCache::Visibility cached_visibility(const Light& light, const hit_record& rec) const {
+        return shadow_cache ? shadow_cache->lookup(light, rec.p, rec.normal) : ShadowCache::Visibility::Unknown;
+    }
+
+    // True if 'light' is hidden from 'rec', from the shadow cache or a ray.
+    bool in_shadow(const SceneManager& manager, const hit_record& rec, const Light& light, const vec3& light_dir) const {
+        ShadowCache::Visibility visibility = cached_visibility(light, rec);
+        if (visibility != ShadowCache::Visibility::Unknown) {
+            return visibility == ShadowCache::Visibility::Shadowed;
+        }
+        hit_record shadow_rec;
+        return manager.hit(shadow_ray(rec, light_dir), interval(0.001, shadow_distance(light, rec.p)), shadow_rec);
+    }
+
+    // Calls visit(light, light_dir, attenuation) for each light that lights
+    // the front of 'rec', before any shadow test: the lights the scene's
+    // LightTree finds in range, or the sampled subset (see
+    // set_light_samples()) with the attenuation divided by its probability.
+    template <typename Visit>
+    void for_each_light(const SceneManager& manager, const hit_record& rec, Visit&& visit) const {
+        auto shade_light = [&](const Light& light, double weight) {
+            vec3 light_dir = light.get_light_direction(rec.p);
+            if (dot(rec.normal, light_dir) <= 0) {
+                return;   // Back-facing
+            }
+            double attenuation = light.get_attenuation(rec.p);
+            if (attenuation <= 0.0) {
+                return;   // Outside a spot light's cone
+            }
+            visit(light, light_dir, attenuation * weight);
+        };
+
+        const LightTree& tree = manager.get_light_tree();
+        if (light_samples == 0 || tree.bounded_count() <= static_cast<size_t>(light_samples)) {
+            tree.for_each_light(rec.p, [&](const Light& light) { shade_light(light, 1.0); });
+            return;
+        }
+        for (const Light* light : tree.unbounded_lights()) {
+            shade_light(*light, 1.0);
+        }
+        for (int i = 0; i < light_samples; ++i) {
+            double pdf;
+            if (const Light* light = tree.sample(rec.p, random_double(0.0, 1.0), pdf)) {
+                shade_light(*light, 1.0 / (light_samples * pdf));
+            }
+        }
+    }
+
+private:
+
     static inline color calculate_diffuse(const vec3& normal, const vec3& light_dir, const color& diffuse_color, double k_diffuse, const color& light_color, double light_intensity) {
-        double diff = std::max(dot(normal, light_dir), 0.0);
+        double diff = std::max<double>(dot(normal, light_dir), 0.0);
         return k_diffuse * diff * diffuse_color * light_color * light_intensity;
     }
 
     static inline color calculate_specular(const vec3& normal, const vec3& light_dir, const vec3& view_dir, double shininess, double k_specular, const color& light_color, double light_intensity) {
         vec3 reflect_dir = reflect(-light_dir, normal);
-        double spec = std::pow(std::max(dot(view_dir, reflect_dir), 0.0), shininess);
+        double spec = std::pow(std::max<double>(dot(view_dir, reflect_dir), 0.0), shininess);
         return k_specular * spec * light_color * light_intensity;
     }
 
+    template <bool shadows>
     color phong_shading(const hit_record& rec, const vec3& view_dir,
-        const hittable& world, const color& diffuse_color, bool renderShadows) const
+        const SceneManager& manager, const color& diffuse_color) const
     {
-        // Ambient light
-        double ambient_light_intensity = 0.4;
-        color ambient_light_color(1.0, 0.95, 0.8);  // Warm yellow
-        color ambient = ambient_light_intensity * ambient_light_color * diffuse_color;
+        color ambient = ambient_light(diffuse_color);
 
         // Initialize diffuse and specular components
         color diffuse(0, 0, 0);
         color specular(0, 0, 0);
-        const double shadow_bias = 1e-3;
-
-        // Get lights directly from the world (SceneManager)
-        const SceneManager* manager_ptr = dynamic_cast<const SceneManager*>(&world);
-        if (!manager_ptr) {
-            return color(0, 0, 0);
-        }
-        const auto& lights = manager_ptr->get_lights();
 
-        // Only parallelize if we have enough lights to justify the overhead
-        if (lights.size() > 4) {
-            int available_threads = omp_get_num_threads();
-            int shading_threads = std::max(1, available_threads / 2);
+        // Lights are evaluated on the calling thread. Pixels are already spread
+        // over every core, so splitting this loop would only add threads.
+        for_each_light(manager, rec, [&](const Light& light, const vec3& light_dir, double attenuation) {
+            // Shadow check, only for lights that would contribute
+            if constexpr (shadows) {
+                if (in_shadow(manager, rec, light, light_dir)) {
+                    return;
+                }
+            }
 
-#pragma omp parallel num_threads(shading_threads) if(lights.size() > 4)
-            {
-                color local_diffuse(0, 0, 0);
-                color local_specular(0, 0, 0);
+            // Diffuse contribution using getters
+            diffuse += calculate_diffuse(
+                rec.normal,
+                light_dir,
+                diffuse_color,
+                rec.material->k_diffuse,
+                light.get_color(),
+                light.get_intensity()
+            ) * attenuation;
+
+            // Specular contribution using getters
+            specular += calculate_specular(
+                rec.normal,
+                light_dir,
+                view_dir,
+                rec.material->shininess,
+                rec.material->k_specular,
+                light.get_color(),
+                light.get_intensity()
+            ) * attenuation;
+        });
 
-#pragma omp for nowait
-                for (int i = 0; i < static_cast<int>(lights.size()); ++i) {
-                    const auto& light = lights[i];
-                    vec3 light_dir = light->get_light_direction(rec.p);
+        // Combine components
+        return ambient + diffuse + specular;
+    }
 
-                    // Skip lights that don't contribute (back-facing)
-                    if (dot(rec.normal, light_dir) <= 0) {
-                        continue;
-                    }
+    // Follows the camera ray 'r' through mirror reflections. Each hit adds its
+    // Phong color weighted by the reflectance left along the path (the
+    // throughput), less its own reflectance, which carries on to the next ray.
+    // The path ends on a miss or a non-reflective surface, after max_depth
+    // rays, or once the throughput drops below min_throughput; with Russian
+    // roulette it then goes on with probability throughput / min_throughput,
+    // reweighted to min_throughput. 'first_hit' is the known hit of 'r', or
+    // null to trace it.
+    template <bool shadows>
+    color trace_path(ray r, const hit_record* first_hit, const SceneManager& manager, PathStats& stats) const {
+        color result(0, 0, 0);
+        double throughput = 1.0;
+        const hit_record* hit = first_hit;
+        hit_record rec;
+        int depth = 0;
+        while (true) {
+            ++depth;
+            if (!hit) {
+                if (!manager.hit(r, interval(0.001, infinity), rec)) {
+                    result += throughput * background_color(r);
+                    break;
+                }
+                hit = &rec;
+            }
 
-                    // Shadow check
-                    if (renderShadows) {
-                        ray shadow_ray(rec.p + rec.normal * shadow_bias, light_dir);
-                        hit_record shadow_rec;
+            // Use the material's color, either from the texture or as a solid color
+            color diffuse_color = hit->material->get_color(hit->u, hit->v);
+            color phong_color = phong_shading<shadows>(*hit, unit_vector(-r.direction()), manager, diffuse_color);
 
-                        double max_distance = (dynamic_cast<DirectionalLight*>(light.get()) != nullptr) ?
-                            infinity : (light->get_position() - rec.p).length();
+            double reflection = hit->material->reflection;
+            if (reflection <= 0.0) {
+                result += throughput * phong_color;
+                break;
+            }
+            result += throughput * (1.0 - reflection) * phong_color;
+            throughput *= reflection;
 
-                        if (world.hit(shadow_ray, interval(0.001, max_distance), shadow_rec)) {
-                            continue;
-                        }
-                    }
-                    // Get attenuation from the light
-                    double attenuation = light->get_attenuation(rec.p);
-
-                    // Diffuse contribution using getters
-                    local_diffuse += calculate_diffuse(
-                        rec.normal,
-                        light_dir,
-                        diffuse_color,
-                        rec.material->k_diffuse,
-                        light->get_color(),
-                        light->get_intensity()
-                    ) * attenuation;
-
-                    // Specular contribution using getters
-                    local_specular += calculate_specular(
-                        rec.normal,
-                        light_dir,
-                        view_dir,
-                        rec.material->shininess,
-                        rec.material->k_specular,
-                        light->get_color(),
-                        light->get_intensity()
-                    ) * attenuation;
+            if (depth == max_depth) {
+                break;
+            }
+            if (throughput < min_throughput) {
+                if (!russian_roulette) {
+                    break;
                 }
-
-#pragma omp critical
-                {
-                    diffuse += local_diffuse;
-                    specular += local_specular;
+                double survival = throughput / min_throughput;
+                if (random_double(0.0, 1.0) >= survival) {
+                    break;
                 }
+                throughput = min_throughput;
+            }
+
+            r = ray(hit->p + hit->normal * 1e-3, reflect(unit_vector(r.direction()), hit->normal), ReflectionRays);
+            hit = nullptr;
+        }
+        stats.add_path(depth);
+        return result;
+    }
+
+    // Where a tile's camera rays find their primary hits: a current
+    // PrimaryRaster, the BVH subtrees the tile's frustum reaches, or the scene
+    // itself when it has no BVH.
+    enum class PrimarySource { Raster, Subtrees, Scene };
+
+    // Primary ray and hit of the first sample of a pixel, kept for the guides
+    // and the hit cache.
+    struct PrimarySample {
+        ray r;
+        hit_record rec;
+        bool hit = false;
+    };
+
+    // Renders 'tile' through the compile-time specialized shading and
+    // projection. Antialiasing jitters 'samples_per_pixel' samples per pixel.
+    // The source of the primary hits is settled once per tile, and the pixel
+    // loop is instantiated for it and for whether first samples are kept.
+    template <Projection projection, bool camera_space, bool antialias, bool shadows>
+    PathStats render_tile_kernel(const SceneManager& manager, const Tile& tile, Uint32* pixels, int samples_per_pixel,
+        GBuffer* guides, std::vector<color>* radiance, int first_row, HitCache* hits) const
+    {
+        const double tan_half_fov = std::tan(0.5 * degrees_to_radians(fov));
+        auto primary_ray = [&](int pixel_x, int pixel_y, double offset_x, double offset_y) {
+            if constexpr (projection == Projection::Orthographic) {
+                return compute_orthographic_ray(pixel_x, pixel_y, offset_x, offset_y);
+            }
+            else {
+                return perspective_ray<camera_space>(pixel_x, pixel_y, offset_x, offset_y, tan_half_fov);
+            }
+        };
+
+        std::vector<color> colors;
+        std::vector<PrimarySample> primary;
+        std::vector<const BVHNode*> subtrees;
+        auto trace = [&](auto source, auto keep) {
+            return trace_tile<antialias, shadows, decltype(source)::value, decltype(keep)::value>(
+                manager, tile, samples_per_pixel, subtrees, primary_ray, colors, primary);
+        };
+        auto trace_from = [&](auto source) {
+            return guides || hits ? trace(source, std::true_type()) : trace(source, std::false_type());
+        };
+
+        PathStats stats;
+        const bool rasterized = !antialias && primary_raster && primary_raster->is_current(manager, raster_view());
+        const std::shared_ptr<BVHNode> bvh = rasterized ? nullptr : manager.getBVH();
+        if (rasterized) {
+            if constexpr (!antialias) {
+                stats = trace_from(std::integral_constant<PrimarySource, PrimarySource::Raster>());
             }
         }
+        else if (bvh) {
+            // The tile's frustum is tested against the BVH once, and the camera
+            // rays only visit the subtrees it reaches; a tile that reaches none
+            // is all background.
+            const ray corners[4] = {
+                primary_ray(tile.x0, tile.y0, 0.0, 0.0),
+                primary_ray(tile.x1 - 1, tile.y0, 1.0, 0.0),
+                primary_ray(tile.x1 - 1, tile.y1 - 1, 1.0, 1.0),
+                primary_ray(tile.x0, tile.y1 - 1, 0.0, 1.0)
+            };
+            const TileFrustum frustum(corners);
+            bvh->collect_subtrees([&](const BoundingBox& box) { return frustum.excludes(box); },
+                CameraRays, max_tile_subtrees, subtrees);
+            std::sort(subtrees.begin(), subtrees.end(), [&](const BVHNode* a, const BVHNode* b) {
+                return frustum.depth(a->bounding_box()) < frustum.depth(b->bounding_box());
+            });
+            stats = trace_from(std::integral_constant<PrimarySource, PrimarySource::Subtrees>());
+        }
         else {
-            // Sequential processing for a small number of lights
-            for (const auto& light : lights) {
-                vec3 light_dir = light->get_light_direction(rec.p);
+            stats = trace_from(std::integral_constant<PrimarySource, PrimarySource::Scene>());
+        }
+        store_tile(manager, tile, pixels, first_row, colors, primary, guides, radiance, hits);
+        return stats;
+    }
 
-                // Skip lights that don't contribute (back-facing)
-                if (dot(rec.normal, light_dir) <= 0) {
-                    continue;
-                }
+    // Pixel loop shared by the tile kernels: traces the pixels of 'tile' into
+    // 'colors', row by row, and with 'keep' their first samples into
+    // 'primary'. 'primary_ray' builds the camera ray of a sample; 'subtrees'
+    // are the BVH subtrees to search for PrimarySource::Subtrees.
+    template <bool antialias, bool shadows, PrimarySource source, bool keep, typename PrimaryRay>
+    PathStats trace_tile(const SceneManager& manager, const Tile& tile, int samples_per_pixel,
+        const std::vector<const BVHNode*>& subtrees, PrimaryRay&& primary_ray,
+        std::vector<color>& colors, std::vector<PrimarySample>& primary) const
+    {
+        static_assert(!(antialias && source == PrimarySource::Raster), "the primary raster only holds pixel centers");
+        const size_t tile_pixels = static_cast<size_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+        colors.resize(tile_pixels);
+        if constexpr (keep) {
+            primary.assign(tile_pixels, PrimarySample());
+        }
+        const int spp = antialias ? samples_per_pixel : 1;
 
-                // Shadow check
-                if (renderShadows) {
-                    ray shadow_ray(rec.p + rec.normal * shadow_bias, light_dir);
-                    hit_record shadow_rec;
+        PathStats stats;
+        size_t index = 0;
+        for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+            for (int pixel_x = tile.x0; pixel_x < tile.x1; ++pixel_x, ++index) {
+                color accumulated_color(0, 0, 0);
 
-                    double max_distance = (dynamic_cast<DirectionalLight*>(light.get()) != nullptr) ?
-                        infinity : (light->get_position() - rec.p).length();
+                for (int s = 0; s < spp; s++) {
+                    double offset_x = antialias ? random_double(0.0, 1.0) : 0.5;
+                    double offset_y = antialias ? random_double(0.0, 1.0) : 0.5;
 
-                    if (world.hit(shadow_ray, interval(0.001, max_distance), shadow_rec)) {
-                        continue;
+                    ray r = primary_ray(pixel_x, pixel_y, offset_x, offset_y);
+
+                    hit_record rec;
+                    bool hit = false;
+                    if constexpr (source == PrimarySource::Raster) {
+                        hit = primary_raster->hit(manager, pixel_x, pixel_y, r, rec);
+                    }
+                    else if constexpr (source == PrimarySource::Scene) {
+                        hit = manager.hit(r, interval(0.001, infinity), rec);
+                    }
+                    else {
+                        double closest_so_far = infinity;
+                        for (const BVHNode* subtree : subtrees) {
+                            if (subtree->hit_closest(r, interval(0.001, closest_so_far), rec)) {
+                                hit = true;
+                                closest_so_far = rec.t;
+                            }
+                        }
+                        if (hit) {
+                            complete_pending_hit(r, rec);
+                        }
+                    }
+                    if constexpr (keep) {
+                        if (s == 0) {
+                            primary[index] = PrimarySample{ r, rec, hit };
+                        }
+                    }
+                    if (hit) {
+                        accumulated_color += trace_path<shadows>(r, &rec, manager, stats);
+                    }
+                    else {
+                        accumulated_color += background_color(r);
+                        stats.add_path(1);
                     }
                 }
 
-                double attenuation = light->get_attenuation(rec.p);
-
-                // Diffuse contribution using getters
-                diffuse += calculate_diffuse(
-                    rec.normal,
-                    light_dir,
-                    diffuse_color,
-                    rec.material->k_diffuse,
-                    light->get_color(),
-                    light->get_intensity()
-                ) * attenuation;
-
-                // Specular contribution using getters
-                specular += calculate_specular(
-                    rec.normal,
-                    light_dir,
-                    view_dir,
-                    rec.material->shininess,
-                    rec.material->k_specular,
-                    light->get_color(),
-                    light->get_intensity()
-                ) * attenuation;
+                // Average color over the samples
+                colors[index] = accumulated_color * (1.0 / spp);
             }
         }
-
-        // Combine components
-        return ambient + diffuse + specular;
+        return stats;
     }
 
-    color shade_ray_at_hit(const ray& r, const hittable& world, int depth = 5, bool renderShadows = true) const {
-        if (depth <= 0) {
-            return color(0, 0, 0);
+    // Writes the colors trace_tile() left for 'tile' to 'pixels', rows of the
+    // camera width starting at image row 'first_row', and to the outputs given;
+    // 'primary' holds the first samples when 'guides' or 'hits' is.
+    void store_tile(const SceneManager& manager, const Tile& tile, Uint32* pixels, int first_row,
+        const std::vector<color>& colors, const std::vector<PrimarySample>& primary,
+        GBuffer* guides, std::vector<color>* radiance, HitCache* hits) const
+    {
+        size_t index = 0;
+        for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+            int flipped_pixel_y = image_height - 1 - (pixel_y - first_row);
+            for (int pixel_x = tile.x0; pixel_x < tile.x1; ++pixel_x, ++index) {
+                write_color(pixels, pixel_x, flipped_pixel_y, image_width, image_height, colors[index]);
+            }
         }
+        if (radiance) {
+            index = 0;
+            for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+                std::copy_n(colors.begin() + index, tile.x1 - tile.x0,
+                    radiance->begin() + static_cast<size_t>(pixel_y) * image_width + tile.x0);
+                index += tile.x1 - tile.x0;
+            }
+        }
+        if (guides) {
+            index = 0;
+            for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+                for (int pixel_x = tile.x0; pixel_x < tile.x1; ++pixel_x, ++index) {
+                    const PrimarySample& sample = primary[index];
+                    store_guide(manager, *guides, pixel_x, pixel_y, sample.hit ? &sample.rec : nullptr);
+                }
+            }
+        }
+        if (hits) {
+            index = 0;
+            for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+                for (int pixel_x = tile.x0; pixel_x < tile.x1; ++pixel_x, ++index) {
+                    const PrimarySample& sample = primary[index];
+                    hits->store(pixel_x, pixel_y, sample.r, sample.hit ? &sample.rec : nullptr);
+                }
+            }
+        }
+    }
 
-        hit_record rec;
-        if (world.hit(r, interval(0.001, infinity), rec)) {
-            vec3 view_dir = unit_vector(-r.direction());
-
-            // Use the material's color, either from the texture or as a solid color
-            color diffuse_color = rec.material->get_color(rec.u, rec.v);
-
-            // Obtain the Phong color for the hit object, now using the texture or solid color. Remove lights from here.
-            color phong_color = phong_shading(rec, view_dir, world, diffuse_color, renderShadows);
+    template <Projection projection, bool camera_space, bool antialias>
+    TileKernel select_kernel() const {
+        return renderShadows
+            ? &Camera::render_tile_kernel<projection, camera_space, antialias, true>
+            : &Camera::render_tile_kernel<projection, camera_space, antialias, false>;
+    }
 
-            // Calculate reflection if the material supports it
-            if (rec.material->reflection > 0.0) {
-                vec3 reflected_dir = reflect(unit_vector(r.direction()), rec.normal);
-                ray reflected_ray(rec.p + rec.normal * 1e-3, reflected_dir);
+    template <bool antialias>
+    TileKernel select_kernel() const {
+        if (is_orthographic()) {
+            return select_kernel<Projection::Orthographic, false, antialias>();
+        }
+        return isCameraSpace
+            ? select_kernel<Projection::Perspective, true, antialias>()
+            : select_kernel<Projection::Perspective, false, antialias>();
+    }
 
-                color reflected_color = shade_ray_at_hit(reflected_ray, world, depth - 1, renderShadows);
+    // Tile kernel for the current settings; render() looks it up once per frame.
+    TileKernel select_kernel(bool antialias) const {
+        return antialias ? select_kernel<true>() : select_kernel<false>();
+    }
 
-                // Combine Phong color with reflection
-                return (1.0 - rec.material->reflection) * phong_color +
-                    rec.material->reflection * reflected_color;
+    template <bool shadows>
+    PathStats relight_tile(const SceneManager& manager, const HitCache& hits, const Tile& tile, Uint32* pixels) const {
+        PathStats stats;
+        for (int pixel_y = tile.y0; pixel_y < tile.y1; ++pixel_y) {
+            for (int pixel_x = tile.x0; pixel_x < tile.x1; ++pixel_x) {
+                const HitCache::Entry& entry = hits.at(pixel_x, pixel_y);
+                ray r(origin, entry.view);
+                color pixel_color(0, 0, 0);
+                if (entry.hit) {
+                    pixel_color = trace_path<shadows>(r, &entry.rec, manager, stats);
+                }
+                else {
+                    pixel_color = background_color(r);
+                    stats.add_path(1);
+                }
+                write_color(pixels, pixel_x, image_height - 1 - pixel_y, image_width, image_height, pixel_color);
             }
-
-            return phong_color;
         }
-
-        return background_color(r);
+        return stats;
     }
 
     // Camera attributes
@@ -523,6 +1018,11 @@ private:
     double ortho_scale = 1.0;
     bool isCameraSpace = false;
     bool renderShadows = true;
+    double min_throughput = default_min_throughput;
+    bool russian_roulette = false;
+    int light_samples = 0;
+    const ShadowCache* shadow_cache = nullptr;
+    const PrimaryRaster* primary_raster = nullptr;
 
     ProjectionFunction current_projection;
 
@@ -531,8 +1031,6 @@ private:
     vec3 up;
     vec3 forward;
 
-    Uint32* pixels;
-
     // Background Colors
     color bg_horizon = vec3(1, 1, 1); // white
     color bg_top = vec3(0.5, 0.7, 1.0); // light blue
@@ -0,0 +1,209 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "color.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "task_pool.h"
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010) over the float
+// radiance of a frame. Each pass convolves with a 5x5 B3-spline kernel whose
+// taps are spread 2^i pixels apart, so five passes cover a 61x61 footprint at
+// 25 taps per pixel and pass. Taps are weighted by how close their normal,
+// tangent plane and color are to the center pixel, and only taps on the same
+// object contribute. Radiance is divided by the surface albedo before filtering
+// and multiplied back afterwards, so texture detail is not blurred.
+class Denoiser {
+public:
+    int iterations = 5;
+    float color_sigma = 0.6f;      // Halved after every pass
+    float plane_sigma = 0.02f;     // Relative to the pixel depth
+
+    // Filters 'radiance' (row-major, top row first) and writes the result to 'target'.
+    void apply(const std::vector<color>& radiance, const GBuffer& guides, FrameBuffer& target) {
+        const int width = guides.width;
+        const int height = guides.height;
+        const size_t count = static_cast<size_t>(width) * height;
+        if (count == 0 || radiance.size() != count) {
+            return;
+        }
+
+        // Compact float copies keep the inner loop in cache
+        edges.resize(count);
+        current.resize(count);
+        next.resize(count);
+
+        TaskPool& pool = TaskPool::shared();
+        pool.parallel_for(0, height, [&](int y) {
+            for (size_t i = static_cast<size_t>(y) * width; i < static_cast<size_t>(y + 1) * width; ++i) {
+                const GBufferSample& sample = guides.samples[i];
+                EdgeGuide& edge = edges[i];
+                edge.object = sample.hit ? sample.object : nullptr;
+                edge.hit = sample.hit;
+                edge.plane_scale = sample.hit ? 1.0f / (std::max(sample.depth, 1e-6f) * plane_sigma) : 0.0f;
+                for (int c = 0; c < 3; ++c) {
+                    edge.normal[c] = sample.normal[c];
+                    edge.position[c] = sample.position[c];
+                }
+
+                color albedo = albedo_of(sample);
+                for (int c = 0; c < 3; ++c) {
+                    current[i].value[c] = static_cast<float>(radiance[i][c] / albedo[c]);
+                }
+            }
+        });
+
+        // 5x5 B3-spline weights, outer product of (1/16, 1/4, 3/8, 1/4, 1/16)
+        static const float spline[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+        float kernel[5][5];
+        for (int j = 0; j < 5; ++j) {
+            for (int i = 0; i < 5; ++i) {
+                kernel[j][i] = spline[j] * spline[i];
+            }
+        }
+        float sigma = color_sigma;
+
+        for (int pass = 0; pass < iterations; ++pass) {
+            const int step = 1 << pass;
+            const float inv_color_variance = 1.0f / (sigma * sigma);
+
+            pool.parallel_for(0, height, [&](int y) {
+                for (int x = 0; x < width; ++x) {
+                    const size_t center_index = static_cast<size_t>(y) * width + x;
+                    const EdgeGuide& center = edges[center_index];
+                    const Texel& center_color = current[center_index];
+
+                    if (!center.hit) {
+                        next[center_index] = center_color;   // Background is noise free
+                        continue;
+                    }
+
+                    // Offset of the center's tangent plane, so a tap's distance to it
+                    // is dot(n, p_tap) - center_plane
+                    const float center_plane = center.normal[0] * center.position[0] +
+                        center.normal[1] * center.position[1] +
+                        center.normal[2] * center.position[2];
+
+                    float sum[3] = { 0.0f, 0.0f, 0.0f };
+                    float weight_sum = 0.0f;
+
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        const int sy = y + dy * step;
+                        if (sy < 0 || sy >= height) {
+                            continue;
+                        }
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            const int sx = x + dx * step;
+                            if (sx < 0 || sx >= width) {
+                                continue;
+                            }
+
+                            const size_t index = static_cast<size_t>(sy) * width + sx;
+                            const EdgeGuide& tap = edges[index];
+                            if (tap.object != center.object || !tap.hit) {
+                                continue;
+                            }
+
+                            float cosine = center.normal[0] * tap.normal[0] +
+                                center.normal[1] * tap.normal[1] +
+                                center.normal[2] * tap.normal[2];
+                            if (cosine <= 0.0f) {
+                                continue;
+                            }
+                            // cosine^64 by repeated squaring
+                            float normal_weight = cosine * cosine;
+                            normal_weight *= normal_weight;
+                            normal_weight *= normal_weight;
+                            normal_weight *= normal_weight;
+                            normal_weight *= normal_weight;
+                            normal_weight *= normal_weight;
+
+                            float plane = (center.normal[0] * tap.position[0] +
+                                center.normal[1] * tap.position[1] +
+                                center.normal[2] * tap.position[2] - center_plane) * center.plane_scale;
+
+                            const Texel& tap_color = current[index];
+                            float d0 = tap_color.value[0] - center_color.value[0];
+                            float d1 = tap_color.value[1] - center_color.value[1];
+                            float d2 = tap_color.value[2] - center_color.value[2];
+                            float color_distance = (d0 * d0 + d1 * d1 + d2 * d2) * inv_color_variance;
+
+                            float weight = kernel[dy + 2][dx + 2] * normal_weight *
+                                edge_falloff(plane * plane + color_distance);
+
+                            sum[0] += weight * tap_color.value[0];
+                            sum[1] += weight * tap_color.value[1];
+                            sum[2] += weight * tap_color.value[2];
+                            weight_sum += weight;
+                        }
+                    }
+
+                    if (weight_sum > 0.0f) {
+                        float inv = 1.0f / weight_sum;
+                        next[center_index] = { { sum[0] * inv, sum[1] * inv, sum[2] * inv } };
+                    }
+                    else {
+                        next[center_index] = center_color;
+                    }
+                }
+            });
+
+            std::swap(current, next);
+            sigma *= 0.5f;
+        }
+
+        target.resize(width, height);
+        Uint32* pixels = target.data();
+
+        pool.parallel_for(0, height, [&](int y) {
+            for (int x = 0; x < width; ++x) {
+                const size_t index = static_cast<size_t>(y) * width + x;
+                const Texel& texel = current[index];
+                color pixel_color = color(texel.value[0], texel.value[1], texel.value[2]) * albedo_of(guides.samples[index]);
+                write_color(pixels, x, height - 1 - y, width, height, pixel_color);
+            }
+        });
+    }
+
+private:
+    struct EdgeGuide {
+        float normal[3];
+        float position[3];
+        float plane_scale;    // 1 / (depth * plane_sigma)
+        const hittable* object;
+        bool hit;
+    };
+
+    struct Texel {
+        float value[3];
+    };
+
+    // Cheap stand-in for exp(-x), x >= 0: the reciprocal of its cubic Taylor
+    // polynomial. Same shape near 0, strictly positive, much faster than expf.
+    static float edge_falloff(float x) {
+        return 1.0f / (1.0f + x * (1.0f + x * (0.5f + x * (1.0f / 6.0f))));
+    }
+
+    // Albedo used for demodulation; background and black surfaces pass through.
+    static color albedo_of(const GBufferSample& sample) {
+        if (!sample.hit) {
+            return color(1, 1, 1);
+        }
+        const double epsilon = 1e-3;
+        return color(
+            std::max(static_cast<double>(sample.albedo[0]), epsilon),
+            std::max(static_cast<double>(sample.albedo[1]), epsilon),
+            std::max(static_cast<double>(sample.albedo[2]), epsilon)
+        );
+    }
+
+    std::vector<EdgeGuide> edges;
+    std::vector<Texel> current;
+    std::vector<Texel> next;
+};
+
+#endif // DENOISER_H
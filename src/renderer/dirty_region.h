@@ -0,0 +1,211 @@
+#ifndef DIRTY_REGION_H
+#define DIRTY_REGION_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "camera.h"
+#include "plane.h"
+#include "scene.h"
+#include "screen_region.h"
+
+// Screen footprint of scene edits, used to re-trace only part of a frame that
+// is otherwise still valid. For every changed box it covers the box itself and
+// the volume it can shadow from each light: the box swept away from the light
+// until it leaves the scene bounds, where every shadow receiver lies.
+// Reflective objects can show a change from anywhere. A single reflective
+// plane shows it at its mirror image, so the mirrored volumes are added;
+// other reflectors, and any plane when there are several, add their own
+// bounds. Everything is dirty for global changes, or when a light sits inside
+// a changed box.
+class DirtyRegion {
+public:
+    static ScreenRegion from_changes(const Camera& camera, const SceneManager& world, const SceneChanges& changes) {
+        ScreenRegion region;
+        if (changes.empty()) {
+            return region;
+        }
+        if (changes.everything || camera.CameraSpaceStatus() || world.getObjects().empty()) {
+            return ScreenRegion::full();
+        }
+
+        BoundingBox scene_bounds = world.bounding_box();
+        for (const BoundingBox& box : changes.bounds) {
+            scene_bounds = scene_bounds.enclose(box);
+        }
+
+        // Hulls whose content may differ from the cached frame
+        std::vector<std::vector<point3>> volumes;
+        for (const BoundingBox& box : changes.bounds) {
+            if (!is_valid(box)) {
+                continue;
+            }
+            const std::vector<point3> corners = box.getVertices();
+            volumes.push_back(corners);
+
+            if (!camera.shadowStatus()) {
+                continue;
+            }
+            for (const auto& light : world.get_lights()) {
+                std::vector<point3> volume = corners;
+                if (dynamic_cast<const DirectionalLight*>(light.get())) {
+                    vec3 away = -light->get_light_direction(box.getCenter());
+                    double length = sweep_length(corners, away, scene_bounds);
+                    for (const point3& corner : corners) {
+                        volume.push_back(corner + away * length);
+                    }
+                }
+                else {
+                    point3 light_position = light->get_position();
+                    if (box.contains(light_position)) {
+                        return ScreenRegion::full();
+                    }
+                    double scale = spread_scale(corners, light_position, box, scene_bounds);
+                    for (const point3& corner : corners) {
+                        volume.push_back(light_position + (corner - light_position) * scale);
+                    }
+                }
+                volumes.push_back(std::move(volume));
+            }
+        }
+
+        std::vector<const plane*> mirrors;
+        std::vector<BoundingBox> reflector_bounds;
+        for (const auto& object : world.getObjects()) {
+            if (!object->is_reflective()) {
+                continue;
+            }
+            if (const plane* mirror = dynamic_cast<const plane*>(object.get())) {
+                mirrors.push_back(mirror);
+            }
+            else {
+                reflector_bounds.push_back(object->bounding_box());
+            }
+        }
+        for (const BoundingBox& box : reflector_bounds) {
+            if (is_valid(box)) {
+                volumes.push_back(box.getVertices());
+            }
+        }
+
+        for (const std::vector<point3>& volume : volumes) {
+            add_hull(camera, volume, region);
+        }
+        if (mirrors.size() == 1) {
+            const point3 origin = mirrors[0]->get_point();
+            const vec3 normal = unit_vector(mirrors[0]->get_normal());
+            for (std::vector<point3> volume : volumes) {
+                for (point3& p : volume) {
+                    p = p - 2.0 * dot(p - origin, normal) * normal;
+                }
+                add_hull(camera, volume, region);
+            }
+        }
+        else {
+            for (const plane* mirror : mirrors) {
+                add_hull(camera, mirror->bounding_box().getVertices(), region);
+            }
+        }
+        return region;
+    }
+
+private:
+    static bool is_valid(const BoundingBox& box) {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!std::isfinite(box.vmin[axis]) || !std::isfinite(box.vmax[axis]) || box.vmin[axis] > box.vmax[axis]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Distance along 'away' after which every corner has left 'bounds' through
+    // one common face, so the swept box is past every receiver.
+    static double sweep_length(const std::vector<point3>& corners, const vec3& away, const BoundingBox& bounds) {
+        double length = infinity;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (std::fabs(away[axis]) < 1e-12) {
+                continue;
+            }
+            double face = away[axis] > 0.0 ? bounds.vmax[axis] : bounds.vmin[axis];
+            double farthest = 0.0;
+            for (const point3& corner : corners) {
+                farthest = std::max(farthest, (face - corner[axis]) / away[axis]);
+            }
+            length = std::min(length, farthest);
+        }
+        return length;
+    }
+
+    // Scale about 'light' after which every corner has left 'bounds' through one
+    // common face. Only faces on an axis where the box lies entirely to one side
+    // of the light can be used; the box does not contain the light, so there is
+    // at least one such axis.
+    static double spread_scale(const std::vector<point3>& corners, const point3& light, const BoundingBox& box, const BoundingBox& bounds) {
+        double scale = infinity;
+        for (int axis = 0; axis < 3; ++axis) {
+            bool above = box.vmin[axis] > light[axis];
+            bool below = box.vmax[axis] < light[axis];
+            if (!above && !below) {
+                continue;
+            }
+            double face = above ? bounds.vmax[axis] : bounds.vmin[axis];
+            double farthest = 1.0;
+            for (const point3& corner : corners) {
+                farthest = std::max(farthest, (face - light[axis]) / (corner[axis] - light[axis]));
+            }
+            scale = std::min(scale, farthest);
+        }
+        return scale;
+    }
+
+    // Adds the screen bounds of the convex hull of 'points'. For a perspective
+    // camera the hull is first cut at a near plane: points behind it are
+    // replaced by where the edges to the points in front cross it.
+    static void add_hull(const Camera& camera, const std::vector<point3>& points, ScreenRegion& region) {
+        constexpr double near_depth = 1e-4;
+        std::vector<point3> visible;
+        if (camera.is_orthographic()) {
+            visible = points;
+        }
+        else {
+            for (const point3& a : points) {
+                double depth_a = camera.view_depth(a);
+                if (depth_a < near_depth) {
+                    continue;
+                }
+                visible.push_back(a);
+                for (const point3& b : points) {
+                    double depth_b = camera.view_depth(b);
+                    if (depth_b < near_depth) {
+                        double t = (depth_a - near_depth) / (depth_a - depth_b);
+                        visible.push_back(a + (b - a) * t);
+                    }
+                }
+            }
+        }
+        if (visible.empty()) {
+            return;   // Entirely behind the camera
+        }
+
+        const double width = camera.get_image_width();
+        const double height = camera.get_image_height();
+        ScreenRegion::Rect rect{ infinity, infinity, -infinity, -infinity };
+        for (const point3& p : visible) {
+            double pixel_x, pixel_y;
+            if (!camera.project_to_pixel(p, pixel_x, pixel_y) || !std::isfinite(pixel_x) || !std::isfinite(pixel_y)) {
+                region.set_everything();
+                return;
+            }
+            rect.x0 = std::min(rect.x0, pixel_x / width);
+            rect.y0 = std::min(rect.y0, pixel_y / height);
+            rect.x1 = std::max(rect.x1, pixel_x / width);
+            rect.y1 = std::max(rect.y1, pixel_y / height);
+        }
+        region.add(rect);
+    }
+};
+
+#endif // DIRTY_REGION_H
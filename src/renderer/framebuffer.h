@@ -0,0 +1,128 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <SDL.h>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+// Per-pixel outputs of a frame besides its color, in the same layout: the
+// distance to the primary hit, its normal and the ObjectID it belongs to.
+// Empty when the frame was produced without them.
+struct FrameAOVs {
+    int width = 0;
+    int height = 0;
+    std::vector<float> depth;        // Infinity where the ray escaped
+    std::vector<float> normal;       // Three floats per pixel
+    std::vector<size_t> object_id;   // SIZE_MAX where no scene object was hit
+
+    void resize(int new_width, int new_height) {
+        width = new_width;
+        height = new_height;
+        const size_t count = static_cast<size_t>(width) * height;
+        depth.resize(count);
+        normal.resize(3 * count);
+        object_id.resize(count);
+    }
+
+    void clear() {
+        width = height = 0;
+        depth.clear();
+        normal.clear();
+        object_id.clear();
+    }
+
+    bool empty() const {
+        return depth.empty();
+    }
+
+    // ObjectID seen at pixel (x, y), if any.
+    std::optional<size_t> object_at(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return std::nullopt;
+        }
+        size_t id = object_id[static_cast<size_t>(y) * width + x];
+        if (id == std::numeric_limits<size_t>::max()) {
+            return std::nullopt;
+        }
+        return id;
+    }
+
+    // Distance to the primary hit at pixel (x, y); infinity outside the frame.
+    float depth_at(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return std::numeric_limits<float>::infinity();
+        }
+        return depth[static_cast<size_t>(y) * width + x];
+    }
+};
+
+// Rays the camera traced for a frame, grouped into paths: a camera ray and
+// the mirror reflections that followed it.
+struct PathStats {
+    uint64_t paths = 0;
+    uint64_t rays = 0;
+
+    void add_path(int ray_count) {
+        ++paths;
+        rays += ray_count;
+    }
+
+    PathStats& operator+=(const PathStats& other) {
+        paths += other.paths;
+        rays += other.rays;
+        return *this;
+    }
+
+    // Average number of reflections per path; 0 when nothing was traced.
+    double average_bounces() const {
+        return paths ? static_cast<double>(rays - paths) / paths : 0.0;
+    }
+};
+
+// CPU-side image the camera traces into. Layout matches the SDL streaming
+// texture (ARGB8888, row-major, top row first).
+struct FrameBuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<Uint32> pixels;
+
+    // Monotonic id of the frame stored here, 0 if nothing was rendered yet.
+    uint64_t frame_id = 0;
+
+    // Wall time spent tracing this frame, in milliseconds.
+    double render_ms = 0.0;
+
+    // Depth, normal and object of every pixel, when the renderer provides them.
+    FrameAOVs aovs;
+
+    // Rays traced for this frame; only the re-traced part after partial updates.
+    PathStats path_stats;
+
+    void resize(int new_width, int new_height) {
+        if (new_width == width && new_height == height) {
+            return;
+        }
+        width = new_width;
+        height = new_height;
+        pixels.assign(static_cast<size_t>(width) * height, 0);
+    }
+
+    void clear() {
+        std::fill(pixels.begin(), pixels.end(), 0);
+        aovs.clear();
+    }
+
+    bool empty() const {
+        return pixels.empty();
+    }
+
+    Uint32* data() { return pixels.data(); }
+    const Uint32* data() const { return pixels.data(); }
+
+    int pitch() const { return width * static_cast<int>(sizeof(Uint32)); }
+};
+
+#endif // FRAMEBUFFER_H
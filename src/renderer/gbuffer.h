@@ -0,0 +1,74 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <cmath>
+
+#include "vec3.h"
+#include "ray.h"
+#include "hit_record.h"
+
+// Primary-hit attributes of one pixel. Stored as floats to keep full-resolution
+// buffers small; the renderer only uses them as guides, not for shading.
+struct GBufferSample {
+    static constexpr size_t no_object = SIZE_MAX;
+
+
+    float depth = std::numeric_limits<float>::infinity();  // Distance along the primary ray
+    float position[3] = { 0.0f, 0.0f, 0.0f };               // Hit point
+    float normal[3] = { 0.0f, 0.0f, 0.0f };                 // Shading normal (faces the camera)
+    float albedo[3] = { 0.0f, 0.0f, 0.0f };                 // Surface color (texture or solid)
+    const hittable* object = nullptr;                       // Object hit; only compared, never dereferenced
+    size_t object_id = no_object;                           // Scene ObjectID of 'object'
+    bool hit = false;                                       // False when the primary ray escaped
+
+    vec3 get_position() const { return vec3(position[0], position[1], position[2]); }
+    vec3 get_normal() const { return vec3(normal[0], normal[1], normal[2]); }
+    vec3 get_albedo() const { return vec3(albedo[0], albedo[1], albedo[2]); }
+};
+
+// Per-pixel primary-hit attributes, row-major with the top row first to match
+// FrameBuffer.
+struct GBuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<GBufferSample> samples;
+
+    void resize(int new_width, int new_height) {
+        if (new_width == width && new_height == height) {
+            return;
+        }
+        width = new_width;
+        height = new_height;
+        samples.assign(static_cast<size_t>(width) * height, GBufferSample());
+    }
+
+    bool empty() const {
+        return samples.empty();
+    }
+
+    GBufferSample& at(int x, int y) { return samples[static_cast<size_t>(y) * width + x]; }
+    const GBufferSample& at(int x, int y) const { return samples[static_cast<size_t>(y) * width + x]; }
+
+    // Records the primary hit for (x, y); pass nullptr when the ray missed.
+    void store(int x, int y, const hit_record* rec, const vec3& surface_albedo = vec3(0, 0, 0), size_t object_id = GBufferSample::no_object) {
+        GBufferSample& sample = at(x, y);
+        if (!rec) {
+            sample = GBufferSample();
+            return;
+        }
+        sample.depth = static_cast<float>(rec->t);
+        for (int i = 0; i < 3; ++i) {
+            sample.position[i] = static_cast<float>(rec->p[i]);
+            sample.normal[i] = static_cast<float>(rec->normal[i]);
+            sample.albedo[i] = static_cast<float>(surface_albedo[i]);
+        }
+        sample.object = rec->hit_object;
+        sample.object_id = object_id;
+        sample.hit = true;
+    }
+};
+
+#endif // GBUFFER_H
@@ -0,0 +1,209 @@
+#ifndef GUIDED_UPSCALER_H
+#define GUIDED_UPSCALER_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "hit_cache.h"
+#include "render_gate.h"
+#include "screen_region.h"
+#include "task_pool.h"
+
+// Shades the scene at 1/factor of the camera resolution and reconstructs the
+// full-size image with a joint-bilateral upsample. Primary visibility is still
+// resolved per output pixel (one BVH query, no lights or reflections), and the
+// resulting depth/normal/object guides decide which low-resolution samples
+// may contribute, so silhouettes stay sharp. Pixels with no compatible sample
+// (thin features missed by the low-resolution pass) are shaded directly. With a
+// region, only the pixels touching it are produced again, from low-resolution
+// pixels traced again around it; the rest of 'target' is kept. Given a
+// HitCache, the low-resolution primary hits are kept so relight() can shade
+// the frame again after light or material edits without any camera rays.
+class GuidedUpscaler {
+public:
+    void render(
+        const Camera& camera,
+        const SceneManager& manager,
+        FrameBuffer& target,
+        int factor,
+        int samples_per_pixel = 1,
+        bool enable_antialias = false,
+        RenderGate* gate = nullptr,
+        const ScreenRegion* region = nullptr,
+        HitCache* hits = nullptr
+    ) {
+        // Camera::set_image_width rejects widths of 100 or less
+        if (factor <= 1 || camera.get_image_width() / factor <= 100) {
+            camera.render(manager, target, samples_per_pixel, enable_antialias, gate, &guides, nullptr, &full_scheduler, region, hits);
+            return;
+        }
+
+        const Camera low_camera = low_resolution(camera, factor);
+        const ScreenRegion all = ScreenRegion::full();
+        if (!region) {
+            region = &all;
+        }
+
+        // Every low-resolution tap of a dirty output pixel is traced again
+        const ScreenRegion low_region = low_footprint(low_camera, *region);
+        low_camera.render(manager, low_frame, samples_per_pixel, enable_antialias, gate, &low_guides, nullptr, &low_scheduler, &low_region, hits);
+        camera.render_guides(manager, guides, gate, region);
+        upsample(camera, manager, target, gate, *region);
+        target.path_stats = low_frame.path_stats;
+    }
+
+    // Shades the frame of the last render() again from 'hits', which that call
+    // filled. The guides are reused as they are, since the geometry is unchanged.
+    void relight(
+        const Camera& camera,
+        const SceneManager& manager,
+        FrameBuffer& target,
+        int factor,
+        const HitCache& hits,
+        RenderGate* gate = nullptr,
+        const ScreenRegion* region = nullptr
+    ) {
+        if (factor <= 1 || camera.get_image_width() / factor <= 100) {
+            camera.relight(manager, target, hits, gate, &full_scheduler, region);
+            return;
+        }
+
+        const Camera low_camera = low_resolution(camera, factor);
+        const ScreenRegion all = ScreenRegion::full();
+        if (!region) {
+            region = &all;
+        }
+
+        const ScreenRegion low_region = low_footprint(low_camera, *region);
+        low_camera.relight(manager, low_frame, hits, gate, &low_scheduler, &low_region);
+        upsample(camera, manager, target, gate, *region);
+        target.path_stats = low_frame.path_stats;
+    }
+
+    // Primary-hit guides of the last output frame, at its full resolution.
+    const GBuffer& output_guides() const {
+        return guides;
+    }
+
+private:
+    static Camera low_resolution(const Camera& camera, int factor) {
+        Camera low_camera = camera;
+        low_camera.set_image_width(camera.get_image_width() / factor);
+        return low_camera;
+    }
+
+    static ScreenRegion low_footprint(const Camera& low_camera, const ScreenRegion& region) {
+        return region.grown(2.0 / low_camera.get_image_width(), 2.0 / low_camera.get_image_height());
+    }
+
+    // Reconstructs the pixels of 'region' from the low-resolution frame and the
+    // guides of both resolutions.
+    void upsample(const Camera& camera, const SceneManager& manager, FrameBuffer& target, RenderGate* gate, const ScreenRegion& region) {
+        const int width = camera.get_image_width();
+        const int height = camera.get_image_height();
+        const int low_width = low_frame.width;
+        target.resize(width, height);
+        Uint32* pixels = target.data();
+        const int low_height = low_frame.height;
+        const double scale_x = static_cast<double>(low_width) / width;
+        const double scale_y = static_cast<double>(low_height) / height;
+
+        TaskPool::shared().parallel_for(0, height, [&](int y) {
+            std::vector<std::pair<int, int>> spans;
+            region.row_spans(y, width, height, 1, spans);
+            if (spans.empty()) {
+                return;
+            }
+            RenderGate::TileScope row_scope(gate);
+
+            // Position of the output pixel center on the low-resolution grid
+            double low_y = (y + 0.5) * scale_y - 0.5;
+            int y0 = std::clamp(static_cast<int>(std::floor(low_y)), 0, low_height - 1);
+            int y1 = std::min(y0 + 1, low_height - 1);
+            double fy = std::clamp(low_y - y0, 0.0, 1.0);
+
+            for (const auto& [first, last] : spans) {
+                for (int x = first; x < last; ++x) {
+                    double low_x = (x + 0.5) * scale_x - 0.5;
+                    int x0 = std::clamp(static_cast<int>(std::floor(low_x)), 0, low_width - 1);
+                    int x1 = std::min(x0 + 1, low_width - 1);
+                    double fx = std::clamp(low_x - x0, 0.0, 1.0);
+
+                    const GBufferSample& guide = guides.at(x, y);
+                    const int tap_x[4] = { x0, x1, x0, x1 };
+                    const int tap_y[4] = { y0, y0, y1, y1 };
+                    const double bilinear[4] = {
+                        (1.0 - fx) * (1.0 - fy), fx * (1.0 - fy),
+                        (1.0 - fx) * fy,         fx * fy
+                    };
+
+                    color sum(0, 0, 0);
+                    double weight_sum = 0.0;
+                    for (int k = 0; k < 4; ++k) {
+                        // The small floor keeps a compatible but distant tap usable
+                        double weight = (bilinear[k] + 1e-3) * guide_weight(guide, low_guides.at(tap_x[k], tap_y[k]));
+                        if (weight > 0.0) {
+                            sum += weight * unpack(low_frame.pixels[static_cast<size_t>(tap_y[k]) * low_width + tap_x[k]]);
+                            weight_sum += weight;
+                        }
+                    }
+
+                    color pixel_color = (weight_sum > 1e-6)
+                        ? sum / weight_sum
+                        : camera.shade_pixel(manager, x, y);
+
+                    int flipped_y = height - 1 - y;
+                    write_color(pixels, x, flipped_y, width, height, pixel_color);
+                }
+            }
+        });
+    }
+
+    // How well a low-resolution sample represents an output pixel. Samples on a
+    // different object, or off the pixel's tangent plane, are rejected.
+    static double guide_weight(const GBufferSample& pixel, const GBufferSample& sample) {
+        if (pixel.hit != sample.hit) {
+            return 0.0;
+        }
+        if (!pixel.hit) {
+            return 1.0;   // Both background
+        }
+        if (pixel.object != sample.object) {
+            return 0.0;
+        }
+
+        // Plane distance is robust at grazing angles, where plain depth differences
+        // between neighbouring pixels are large even on a flat surface.
+        vec3 normal = pixel.get_normal();
+        double plane_distance = std::fabs(dot(normal, sample.get_position() - pixel.get_position())) / std::max(pixel.depth, 1e-6f);
+        double depth_weight = std::exp(-(plane_distance * plane_distance) / (2.0 * depth_sigma * depth_sigma));
+
+        double normal_weight = std::pow(std::max<double>(dot(normal, sample.get_normal()), 0.0), normal_power);
+        return depth_weight * normal_weight;
+    }
+
+    // Inverse of write_color: maps each byte back to the center of its bucket.
+    static color unpack(Uint32 pixel) {
+        return color(
+            (((pixel >> 16) & 0xFF) + 0.5) / 256.0,
+            (((pixel >> 8) & 0xFF) + 0.5) / 256.0,
+            ((pixel & 0xFF) + 0.5) / 256.0
+        );
+    }
+
+    static constexpr double depth_sigma = 0.01;   // Relative to the pixel depth
+    static constexpr double normal_power = 16.0;
+
+    TileScheduler low_scheduler;    // Separate schedulers keep each resolution's cost history
+    TileScheduler full_scheduler;
+    FrameBuffer low_frame;
+    GBuffer low_guides;
+    GBuffer guides;
+};
+
+#endif // GUIDED_UPSCALER_H
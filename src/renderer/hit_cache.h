@@ -0,0 +1,48 @@
+#ifndef HIT_CACHE_H
+#define HIT_CACHE_H
+
+#include <vector>
+
+#include "hit_record.h"
+#include "ray.h"
+#include "vec3.h"
+
+// Primary hit of every pixel center, complete enough to shade the pixel again
+// without tracing its camera ray: position, normal, material, UV and the view
+// direction. Materials are referenced rather than copied, so in-place material
+// edits show when the cache is shaded again; moving, adding or removing
+// objects, or changing the view, makes it stale. Row-major with the top row
+// first to match FrameBuffer.
+struct HitCache {
+    struct Entry {
+        hit_record rec;               // Material ID is rec.material
+        vec3 view = vec3(0, 0, 0);    // Direction of the camera ray
+        bool hit = false;             // False when the camera ray escaped
+    };
+
+    int width = 0;
+    int height = 0;
+    std::vector<Entry> entries;
+
+    void resize(int new_width, int new_height) {
+        if (new_width == width && new_height == height) {
+            return;
+        }
+        width = new_width;
+        height = new_height;
+        entries.assign(static_cast<size_t>(width) * height, Entry());
+    }
+
+    Entry& at(int x, int y) { return entries[static_cast<size_t>(y) * width + x]; }
+    const Entry& at(int x, int y) const { return entries[static_cast<size_t>(y) * width + x]; }
+
+    // Records the camera ray of (x, y) and its hit; pass nullptr when it missed.
+    void store(int x, int y, const ray& r, const hit_record* rec) {
+        Entry& entry = at(x, y);
+        entry.view = r.direction();
+        entry.hit = rec != nullptr;
+        entry.rec = rec ? *rec : hit_record();
+    }
+};
+
+#endif // HIT_CACHE_H
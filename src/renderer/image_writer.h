@@ -0,0 +1,185 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <SDL.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Writes a binary PPM (P6) one horizontal band at a time, each band straight
+// to its place in the file, so an image of any size needs a single band in
+// memory. Every finished band is also appended to a checkpoint next to the
+// image ("<path>.progress"); opening with 'resume' keeps the bands listed there
+// and reports them as done, so an interrupted render continues where it
+// stopped. The checkpoint is removed once the last band is written.
+class StreamingImageWriter {
+public:
+    StreamingImageWriter(std::string path, int width, int height, int band_height, bool resume)
+        : path(std::move(path)),
+        checkpoint_path(this->path + ".progress"),
+        width(width),
+        height(height),
+        band_height(std::max(band_height, 1)) {
+        if (width <= 0 || height <= 0) {
+            throw std::invalid_argument("Image size must be positive.");
+        }
+        band_done.assign((height + this->band_height - 1) / this->band_height, false);
+
+        if (!(resume && reopen())) {
+            create();
+        }
+        checkpoint.open(checkpoint_path, std::ios::app);
+        if (!checkpoint) {
+            throw std::runtime_error("Could not write checkpoint " + checkpoint_path);
+        }
+    }
+
+    StreamingImageWriter(const StreamingImageWriter&) = delete;
+    StreamingImageWriter& operator=(const StreamingImageWriter&) = delete;
+
+    const std::string& get_path() const { return path; }
+    int get_band_height() const { return band_height; }
+    int band_count() const { return static_cast<int>(band_done.size()); }
+
+    bool is_band_done(int band) const {
+        return band_done[band];
+    }
+
+    // Image rows covered by a band; the last band may be shorter.
+    int band_rows(int band) const {
+        return std::min(band_height, height - band * band_height);
+    }
+
+    // Pixels in the bands already written, including resumed ones.
+    size_t completed_pixels() const {
+        size_t rows = 0;
+        for (int band = 0; band < band_count(); ++band) {
+            if (band_done[band]) {
+                rows += band_rows(band);
+            }
+        }
+        return rows * width;
+    }
+
+    bool is_complete() const {
+        return std::all_of(band_done.begin(), band_done.end(), [](bool done) { return done; });
+    }
+
+    // Stores band 'band' from 'pixels' (band_rows(band) rows of 0x00RRGGBB, top
+    // row first) and records it in the checkpoint. The image data is flushed
+    // before the checkpoint entry, so a listed band is always on disk.
+    void write_band(int band, const Uint32* pixels) {
+        const int rows = band_rows(band);
+        row_bytes.resize(static_cast<size_t>(rows) * width * 3);
+        for (size_t i = 0; i < static_cast<size_t>(rows) * width; ++i) {
+            row_bytes[3 * i + 0] = static_cast<char>((pixels[i] >> 16) & 0xFF);
+            row_bytes[3 * i + 1] = static_cast<char>((pixels[i] >> 8) & 0xFF);
+            row_bytes[3 * i + 2] = static_cast<char>(pixels[i] & 0xFF);
+        }
+
+        image.seekp(header_size + static_cast<std::streamoff>(band) * band_height * width * 3);
+        image.write(row_bytes.data(), static_cast<std::streamsize>(row_bytes.size()));
+        image.flush();
+        if (!image) {
+            throw std::runtime_error("Could not write to " + path);
+        }
+
+        checkpoint << band << '\n';
+        checkpoint.flush();
+        band_done[band] = true;
+
+        if (is_complete()) {
+            checkpoint.close();
+            std::remove(checkpoint_path.c_str());
+        }
+    }
+
+private:
+    std::string header() const {
+        return "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    }
+
+    std::string checkpoint_header() const {
+        return std::to_string(width) + " " + std::to_string(height) + " " + std::to_string(band_height);
+    }
+
+    // Starts a new image: the header, then the pixel area extended to its full
+    // size (sparse on most file systems) so bands can be written in any order.
+    void create() {
+        std::fill(band_done.begin(), band_done.end(), false);
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            std::string text = header();
+            file.write(text.data(), static_cast<std::streamsize>(text.size()));
+            file.seekp(static_cast<std::streamoff>(text.size()) + static_cast<std::streamoff>(width) * height * 3 - 1);
+            file.put(0);
+            if (!file) {
+                throw std::runtime_error("Could not create " + path);
+            }
+        }
+        {
+            std::ofstream file(checkpoint_path, std::ios::trunc);
+            file << checkpoint_header() << '\n';
+        }
+        open_image();
+    }
+
+    // Continues an earlier render of the same size. Returns false when there is
+    // nothing compatible to resume.
+    bool reopen() {
+        std::ifstream existing(path, std::ios::binary);
+        std::ifstream progress(checkpoint_path);
+        if (!existing || !progress) {
+            return false;
+        }
+
+        std::string expected = header();
+        std::string found(expected.size(), '\0');
+        existing.read(&found[0], static_cast<std::streamsize>(found.size()));
+        std::string line;
+        if (found != expected || !std::getline(progress, line) || line != checkpoint_header()) {
+            std::cerr << "Cannot resume " << path << ": size or band layout differs, starting over." << std::endl;
+            return false;
+        }
+
+        // A last line without its newline was cut short; that band is redone
+        while (std::getline(progress, line) && !progress.eof()) {
+            std::istringstream entry(line);
+            int band;
+            if (entry >> band && band >= 0 && band < band_count()) {
+                band_done[band] = true;
+            }
+        }
+        open_image();
+        return true;
+    }
+
+    void open_image() {
+        header_size = static_cast<std::streamoff>(header().size());
+        image.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!image) {
+            throw std::runtime_error("Could not open " + path);
+        }
+    }
+
+    const std::string path;
+    const std::string checkpoint_path;
+    const int width;
+    const int height;
+    const int band_height;
+
+    std::fstream image;
+    std::ofstream checkpoint;
+    std::streamoff header_size = 0;
+    std::vector<bool> band_done;
+    std::vector<char> row_bytes;   // Scratch for the band being written
+};
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,433 @@
+#ifndef PRIMARY_RASTER_H
+#define PRIMARY_RASTER_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "box.h"
+#include "bvh_node.h"
+#include "interval.h"
+#include "mesh.h"
+#include "ray.h"
+#include "scene.h"
+#include "task_pool.h"
+#include "triangle.h"
+#include "vec3.h"
+
+// Primary visibility of triangle geometry by rasterization instead of ray
+// casting. The triangles of every Mesh and box are projected with the camera
+// and rasterized at the pixel centers into a depth and triangle buffer. The
+// screen is cut into bins filled in parallel by a half-space rasterizer, and
+// each bin keeps a hierarchical Z-buffer: the farthest depth of each block of
+// pixels, which rejects triangles behind everything already drawn there
+// without testing their pixels. A camera ray then intersects only the
+// triangle found for its pixel, which gives the exact hit, plus a BVH of the
+// other objects (analytic primitives, CSG nodes and planes), which are still
+// ray cast. The buffers are only valid for the scene revision and view they
+// were rasterized for.
+class PrimaryRaster {
+public:
+    // The projection of the camera rays; see Camera::raster_view().
+    struct View {
+        point3 origin;
+        vec3 right, up, forward;   // The camera looks down -forward
+        int width = 0;
+        int height = 0;
+        double aspect_ratio = 1.0;
+        double tan_half_fov = 1.0;
+        double ortho_scale = 1.0;
+        bool orthographic = false;
+
+        bool operator==(const View& other) const {
+            return origin == other.origin && right == other.right && up == other.up && forward == other.forward &&
+                width == other.width && height == other.height && aspect_ratio == other.aspect_ratio &&
+                tan_half_fov == other.tan_half_fov && ortho_scale == other.ortho_scale && orthographic == other.orthographic;
+        }
+    };
+
+    void rasterize(const View& new_view, const SceneManager& world) {
+        view = new_view;
+        scene = &world;
+        revision = world.get_revision();
+        collect(world);
+
+        const size_t pixel_count = static_cast<size_t>(view.width) * view.height;
+        depth.assign(pixel_count, std::numeric_limits<double>::infinity());
+        ids.assign(pixel_count, -1);
+        setup();
+        bin();
+
+        TaskPool::shared().parallel_for(0, bins_x * bins_y, [&](int bin) {
+            rasterize_bin(bin % bins_x, bin / bins_x);
+        });
+    }
+
+    // Drops the buffers and the references to the scene's objects.
+    void reset() {
+        scene = nullptr;
+        sources.clear();
+        owners.clear();
+        analytic = nullptr;
+        screen.clear();
+        bins.clear();
+        depth.clear();
+        ids.clear();
+    }
+
+    bool is_current(const SceneManager& world, const View& camera_view) const {
+        return scene == &world && revision == world.get_revision() && view == camera_view;
+    }
+
+    // Closest hit of the camera ray 'r' through the center of pixel (x, y).
+    // Falls back to tracing 'r' through 'world' when the rasterized triangle
+    // and the ray disagree, which only happens at its edges.
+    bool hit(const SceneManager& world, int pixel_x, int pixel_y, const ray& r, hit_record& rec) const {
+        const double inf = std::numeric_limits<double>::infinity();
+        const int id = ids[static_cast<size_t>(pixel_y) * view.width + pixel_x];
+        bool hit_anything = false;
+        double closest_so_far = inf;
+        if (id >= 0) {
+            const Source& source = sources[id];
+            const ray local = source.placement ? source.placement->to_local(r) : r;
+            if (!source.tri->hit_closest(local, interval(0.001, inf), rec)) {
+                return world.hit(r, interval(0.001, inf), rec);
+            }
+            rec.hit_object = source.object;
+            if (source.placement) {
+                // The mesh completes the hit in its own space, as in Mesh::hit_closest()
+                rec.pending_part = rec.pending;
+                rec.pending = source.object;
+            }
+            hit_anything = true;
+            closest_so_far = rec.t;
+        }
+        if (analytic && analytic->hit_closest(r, interval(0.001, closest_so_far), rec)) {
+            hit_anything = true;
+        }
+        if (hit_anything) {
+            complete_pending_hit(r, rec);
+        }
+        return hit_anything;
+    }
+
+    size_t triangle_count() const {
+        return sources.size();
+    }
+
+private:
+    static constexpr int bin_size = 32;
+    static constexpr int block_size = 8;
+    static constexpr int blocks_per_bin = bin_size / block_size;
+
+    // Triangles behind this depth are clipped away, as camera rays start
+    // at t = 0.001.
+    static constexpr double near_depth = 1e-3;
+
+    // A rasterized triangle and the top-level object reported for its hits.
+    // 'placement' maps the triangle to the world when its mesh has one.
+    struct Source {
+        const triangle* tri;
+        const hittable* object;
+        const ObjectTransform* placement;
+    };
+
+    // A projected triangle, counter-clockwise on screen. 'z' is the depth key:
+    // the view depth for orthographic views and minus its inverse for
+    // perspective ones, so that it is linear on screen and smaller is nearer.
+    struct ScreenTriangle {
+        double x[3], y[3], z[3];
+        double min_z;
+        int x0, y0, x1, y1;   // Pixels whose centers the bounds overlap
+        int source;
+    };
+
+    // Edge function a * x + b * y + c, positive inside
+    struct Edge {
+        double a, b, c;
+
+        Edge(double x0, double y0, double x1, double y1)
+            : a(y0 - y1), b(x1 - x0), c(x0 * y1 - x1 * y0) {
+        }
+
+        double at(double x, double y) const {
+            return a * x + b * y + c;
+        }
+    };
+
+    // Splits the scene into the triangles of meshes and boxes and a BVH of
+    // everything else. Objects hidden from camera rays are left out.
+    void collect(const SceneManager& world) {
+        sources.clear();
+        owners.clear();
+        std::vector<std::shared_ptr<hittable>> others;
+        for (const auto& object : world.getObjects()) {
+            if ((object->get_ray_visibility() & CameraRays) == 0) {
+                continue;
+            }
+            const std::vector<std::shared_ptr<triangle>>* triangles = nullptr;
+            const ObjectTransform* placement = nullptr;
+            if (const Mesh* mesh = dynamic_cast<const Mesh*>(object.get())) {
+                triangles = &mesh->getTriangles();
+                if (!mesh->get_placement().is_identity()) {
+                    placement = &mesh->get_placement();
+                }
+            }
+            else if (const box* cube = dynamic_cast<const box*>(object.get())) {
+                triangles = &cube->getTriangles();
+            }
+            if (!triangles) {
+                others.push_back(object);
+                continue;
+            }
+            // Held so that the triangles outlive edits made during the frame
+            owners.push_back(object);
+            for (const auto& tri : *triangles) {
+                sources.push_back({ tri.get(), object.get(), placement });
+            }
+        }
+        analytic = others.empty() ? nullptr : std::make_shared<BVHNode>(others, 0, others.size());
+    }
+
+    // Projects every source triangle, clipped to the near plane, into 'screen'.
+    void setup() {
+        TaskPool& pool = TaskPool::shared();
+        const int chunks = std::max(1, std::min(static_cast<int>(sources.size() / 256), 4 * pool.concurrency()));
+        std::vector<std::vector<ScreenTriangle>> chunk_triangles(chunks);
+        pool.parallel_for(0, chunks, [&](int chunk) {
+            const size_t first = sources.size() * chunk / chunks;
+            const size_t last = sources.size() * (chunk + 1) / chunks;
+            for (size_t i = first; i < last; ++i) {
+                const triangle& tri = *sources[i].tri;
+                if (const ObjectTransform* placement = sources[i].placement) {
+                    clip_and_project(placement->point_to_world(tri.get_v0()), placement->point_to_world(tri.get_v1()),
+                        placement->point_to_world(tri.get_v2()), static_cast<int>(i), chunk_triangles[chunk]);
+                }
+                else {
+                    clip_and_project(tri.get_v0(), tri.get_v1(), tri.get_v2(), static_cast<int>(i), chunk_triangles[chunk]);
+                }
+            }
+        });
+        screen.clear();
+        for (const auto& triangles : chunk_triangles) {
+            screen.insert(screen.end(), triangles.begin(), triangles.end());
+        }
+    }
+
+    double view_depth(const point3& p) const {
+        return -dot(p - view.origin, view.forward);
+    }
+
+    void clip_and_project(const point3& a, const point3& b, const point3& c, int source, std::vector<ScreenTriangle>& out) const {
+        const point3 corners[3] = { a, b, c };
+        double depths[3];
+        int in_front = 0;
+        for (int i = 0; i < 3; ++i) {
+            depths[i] = view_depth(corners[i]);
+            in_front += depths[i] >= near_depth;
+        }
+        if (in_front == 3) {
+            project(corners[0], corners[1], corners[2], source, out);
+            return;
+        }
+        if (in_front == 0) {
+            return;
+        }
+
+        // Sutherland-Hodgman against the near plane: three or four corners
+        point3 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i) {
+            const int j = (i + 1) % 3;
+            if (depths[i] >= near_depth) {
+                polygon[count++] = corners[i];
+            }
+            if ((depths[i] >= near_depth) != (depths[j] >= near_depth)) {
+                double s = (near_depth - depths[i]) / (depths[j] - depths[i]);
+                polygon[count++] = corners[i] + s * (corners[j] - corners[i]);
+            }
+        }
+        for (int i = 2; i < count; ++i) {
+            project(polygon[0], polygon[i - 1], polygon[i], source, out);
+        }
+    }
+
+    void project(const point3& a, const point3& b, const point3& c, int source, std::vector<ScreenTriangle>& out) const {
+        ScreenTriangle t;
+        const point3 corners[3] = { a, b, c };
+        for (int i = 0; i < 3; ++i) {
+            const vec3 offset = corners[i] - view.origin;
+            const double depth_i = std::max<double>(-dot(offset, view.forward), near_depth);
+            double screen_x = dot(offset, view.right);
+            double screen_y = dot(offset, view.up);
+            if (view.orthographic) {
+                screen_x /= view.aspect_ratio * view.ortho_scale;
+                screen_y /= view.ortho_scale;
+                t.z[i] = depth_i;
+            }
+            else {
+                screen_x /= depth_i * view.aspect_ratio * view.tan_half_fov;
+                screen_y /= depth_i * view.tan_half_fov;
+                t.z[i] = -1.0 / depth_i;
+            }
+            t.x[i] = (screen_x + 1.0) * 0.5 * view.width;
+            t.y[i] = (1.0 - screen_y) * 0.5 * view.height;
+        }
+
+        const double area = Edge(t.x[0], t.y[0], t.x[1], t.y[1]).at(t.x[2], t.y[2]);
+        if (area == 0.0 || !std::isfinite(area)) {
+            return;
+        }
+        if (area < 0.0) {
+            std::swap(t.x[1], t.x[2]);
+            std::swap(t.y[1], t.y[2]);
+            std::swap(t.z[1], t.z[2]);
+        }
+
+        // Pixels (i, j) with centers (i + 0.5, j + 0.5) inside the bounds
+        const double min_x = std::min({ t.x[0], t.x[1], t.x[2] });
+        const double max_x = std::max({ t.x[0], t.x[1], t.x[2] });
+        const double min_y = std::min({ t.y[0], t.y[1], t.y[2] });
+        const double max_y = std::max({ t.y[0], t.y[1], t.y[2] });
+        t.x0 = static_cast<int>(std::max(std::ceil(min_x - 0.5), 0.0));
+        t.x1 = static_cast<int>(std::min(std::floor(max_x - 0.5) + 1.0, static_cast<double>(view.width)));
+        t.y0 = static_cast<int>(std::max(std::ceil(min_y - 0.5), 0.0));
+        t.y1 = static_cast<int>(std::min(std::floor(max_y - 0.5) + 1.0, static_cast<double>(view.height)));
+        if (t.x0 >= t.x1 || t.y0 >= t.y1) {
+            return;
+        }
+        t.min_z = std::min({ t.z[0], t.z[1], t.z[2] });
+        t.source = source;
+        out.push_back(t);
+    }
+
+    // Lists the triangles overlapping each bin, in source order.
+    void bin() {
+        bins_x = (view.width + bin_size - 1) / bin_size;
+        bins_y = (view.height + bin_size - 1) / bin_size;
+        bins.assign(static_cast<size_t>(bins_x) * bins_y, {});
+        for (size_t i = 0; i < screen.size(); ++i) {
+            const ScreenTriangle& t = screen[i];
+            for (int by = t.y0 / bin_size; by <= (t.y1 - 1) / bin_size; ++by) {
+                for (int bx = t.x0 / bin_size; bx <= (t.x1 - 1) / bin_size; ++bx) {
+                    bins[static_cast<size_t>(by) * bins_x + bx].push_back(static_cast<int>(i));
+                }
+            }
+        }
+    }
+
+    void rasterize_bin(int bin_x, int bin_y) {
+        const int bin_x0 = bin_x * bin_size;
+        const int bin_y0 = bin_y * bin_size;
+        const int bin_x1 = std::min(bin_x0 + bin_size, view.width);
+        const int bin_y1 = std::min(bin_y0 + bin_size, view.height);
+
+        // Farthest depth drawn in each block, infinite while it has gaps
+        double block_far[blocks_per_bin * blocks_per_bin];
+        std::fill(std::begin(block_far), std::end(block_far), std::numeric_limits<double>::infinity());
+
+        for (int index : bins[static_cast<size_t>(bin_y) * bins_x + bin_x]) {
+            const ScreenTriangle& t = screen[index];
+            const Edge edges[3] = {
+                Edge(t.x[1], t.y[1], t.x[2], t.y[2]),
+                Edge(t.x[2], t.y[2], t.x[0], t.y[0]),
+                Edge(t.x[0], t.y[0], t.x[1], t.y[1])
+            };
+            const double inverse_area = 1.0 / edges[2].at(t.x[2], t.y[2]);
+
+            const int x0 = std::max(t.x0, bin_x0);
+            const int x1 = std::min(t.x1, bin_x1);
+            const int y0 = std::max(t.y0, bin_y0);
+            const int y1 = std::min(t.y1, bin_y1);
+            for (int block_y = (y0 - bin_y0) / block_size; block_y <= (y1 - 1 - bin_y0) / block_size; ++block_y) {
+                for (int block_x = (x0 - bin_x0) / block_size; block_x <= (x1 - 1 - bin_x0) / block_size; ++block_x) {
+                    double& far_z = block_far[block_y * blocks_per_bin + block_x];
+                    if (t.min_z > far_z) {
+                        continue;
+                    }
+                    const int px0 = std::max(x0, bin_x0 + block_x * block_size);
+                    const int px1 = std::min(x1, bin_x0 + (block_x + 1) * block_size);
+                    const int py0 = std::max(y0, bin_y0 + block_y * block_size);
+                    const int py1 = std::min(y1, bin_y0 + (block_y + 1) * block_size);
+                    if (outside(edges, px0 + 0.5, py0 + 0.5, px1 - 0.5, py1 - 0.5)) {
+                        continue;
+                    }
+                    if (draw(t, edges, inverse_area, px0, py0, px1, py1)) {
+                        far_z = farthest(bin_x0 + block_x * block_size, bin_y0 + block_y * block_size);
+                    }
+                }
+            }
+        }
+    }
+
+    // True if some edge has the whole rectangle outside
+    static bool outside(const Edge edges[3], double x0, double y0, double x1, double y1) {
+        for (int i = 0; i < 3; ++i) {
+            const Edge& e = edges[i];
+            if (e.at(e.a > 0.0 ? x1 : x0, e.b > 0.0 ? y1 : y0) < 0.0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Depth-tests the triangle at the pixel centers of [x0, x1) x [y0, y1);
+    // returns true if any pixel changed.
+    bool draw(const ScreenTriangle& t, const Edge edges[3], double inverse_area, int x0, int y0, int x1, int y1) {
+        bool drawn = false;
+        for (int y = y0; y < y1; ++y) {
+            const double center_y = y + 0.5;
+            double w[3];
+            for (int i = 0; i < 3; ++i) {
+                w[i] = edges[i].at(x0 + 0.5, center_y);
+            }
+            double* depth_row = &depth[static_cast<size_t>(y) * view.width];
+            int* id_row = &ids[static_cast<size_t>(y) * view.width];
+            for (int x = x0; x < x1; ++x) {
+                if (w[0] >= 0.0 && w[1] >= 0.0 && w[2] >= 0.0) {
+                    const double z = (w[0] * t.z[0] + w[1] * t.z[1] + w[2] * t.z[2]) * inverse_area;
+                    // Equal depths go to the first triangle in source order
+                    if (z < depth_row[x] || (z == depth_row[x] && t.source < id_row[x])) {
+                        depth_row[x] = z;
+                        id_row[x] = t.source;
+                        drawn = true;
+                    }
+                }
+                for (int i = 0; i < 3; ++i) {
+                    w[i] += edges[i].a;
+                }
+            }
+        }
+        return drawn;
+    }
+
+    double farthest(int x0, int y0) const {
+        double far_z = -std::numeric_limits<double>::infinity();
+        for (int y = y0; y < std::min(y0 + block_size, view.height); ++y) {
+            for (int x = x0; x < std::min(x0 + block_size, view.width); ++x) {
+                far_z = std::max(far_z, depth[static_cast<size_t>(y) * view.width + x]);
+            }
+        }
+        return far_z;
+    }
+
+    View view;
+    const SceneManager* scene = nullptr;
+    uint64_t revision = 0;
+
+    std::vector<Source> sources;
+    std::vector<std::shared_ptr<hittable>> owners;
+    std::shared_ptr<BVHNode> analytic;   // Everything that is not rasterized
+
+    std::vector<ScreenTriangle> screen;
+    std::vector<std::vector<int>> bins;
+    int bins_x = 0;
+    int bins_y = 0;
+
+    std::vector<double> depth;   // Depth key of the nearest triangle per pixel
+    std::vector<int> ids;        // Its index in 'sources', -1 for none
+};
+
+#endif // PRIMARY_RASTER_H
@@ -0,0 +1,72 @@
+#ifndef RENDER_GATE_H
+#define RENDER_GATE_H
+
+#include <mutex>
+#include <condition_variable>
+
+// Synchronizes scene edits on the UI thread with tracing on the render thread.
+// Render threads enter the gate once per tile; the UI thread closes it while it
+// mutates the scene, which waits for in-flight tiles to drain and holds new
+// tiles back until the edit is done. The worst-case UI stall is one tile, or
+// one frame of WavefrontRenderer, which holds the gate for all its stages.
+class RenderGate {
+public:
+    void enter_tile() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !editing; });
+        ++active_tiles;
+    }
+
+    void leave_tile() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active_tiles == 0) {
+            cv.notify_all();
+        }
+    }
+
+    void begin_edit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        editing = true;
+        cv.wait(lock, [this] { return active_tiles == 0; });
+    }
+
+    void end_edit() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            editing = false;
+        }
+        cv.notify_all();
+    }
+
+    // RAII helper for the UI thread. Held only around the statements that
+    // mutate the scene; a null gate means nothing renders concurrently.
+    class EditScope {
+    public:
+        explicit EditScope(RenderGate& gate) : gate(&gate) { gate.begin_edit(); }
+        explicit EditScope(RenderGate* gate) : gate(gate) { if (gate) gate->begin_edit(); }
+        ~EditScope() { if (gate) gate->end_edit(); }
+        EditScope(const EditScope&) = delete;
+        EditScope& operator=(const EditScope&) = delete;
+    private:
+        RenderGate* gate;
+    };
+
+    // RAII helper for render threads.
+    class TileScope {
+    public:
+        explicit TileScope(RenderGate* gate) : gate(gate) { if (gate) gate->enter_tile(); }
+        ~TileScope() { if (gate) gate->leave_tile(); }
+        TileScope(const TileScope&) = delete;
+        TileScope& operator=(const TileScope&) = delete;
+    private:
+        RenderGate* gate;
+    };
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int active_tiles = 0;
+    bool editing = false;
+};
+
+#endif // RENDER_GATE_H
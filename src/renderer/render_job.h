@@ -0,0 +1,309 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "denoiser.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "image_writer.h"
+#include "scene.h"
+#include "task_pool.h"
+#include "tile_scheduler.h"
+
+// A final render running on its own thread. It traces a private snapshot of
+// the scene, so the UI can keep editing and the interactive preview keeps
+// running; while any job runs, the preview is traced on the background lane of
+// the TaskPool and hands its workers to the job. Finished tiles are published
+// to a display copy that the UI polls, together with progress and an ETA.
+// With 'denoise' set, the finished frame is replaced by its filtered version.
+// Jobs given a StreamingImageWriter keep no frame at all: they trace one band
+// of rows at a time and hand each finished band to the writer, so memory does
+// not grow with the image size, and they have nothing to show in the viewport.
+class RenderJob {
+public:
+    enum class State { Running, Finished, Cancelled, Failed };
+
+    RenderJob(const Camera& camera, std::unique_ptr<SceneManager> scene, int samples_per_pixel, bool enable_antialias, bool denoise, std::string label)
+        : camera(camera),
+        scene(std::move(scene)),
+        samples_per_pixel(samples_per_pixel),
+        enable_antialias(enable_antialias),
+        denoise(denoise),
+        label(std::move(label)),
+        start_time(std::chrono::steady_clock::now()) {
+        frame.resize(camera.get_image_width(), camera.get_image_height());
+        display.resize(frame.width, frame.height);
+        if (denoise) {
+            guides.resize(frame.width, frame.height);
+            radiance.resize(frame.pixels.size());
+        }
+        ++running_jobs;
+        worker = std::thread(&RenderJob::run, this);
+    }
+
+    RenderJob(const Camera& camera, std::unique_ptr<SceneManager> scene, int samples_per_pixel, bool enable_antialias, std::unique_ptr<StreamingImageWriter> output, std::string label)
+        : camera(camera),
+        scene(std::move(scene)),
+        samples_per_pixel(samples_per_pixel),
+        enable_antialias(enable_antialias),
+        denoise(false),
+        label(std::move(label)),
+        start_time(std::chrono::steady_clock::now()),
+        output(std::move(output)) {
+        resumed_pixels = this->output->completed_pixels();
+        completed_pixels = resumed_pixels;
+        ++running_jobs;
+        worker = std::thread(&RenderJob::run, this);
+    }
+
+    ~RenderJob() {
+        cancel();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    RenderJob(const RenderJob&) = delete;
+    RenderJob& operator=(const RenderJob&) = delete;
+
+    // Number of jobs still tracing, across all instances.
+    static int running_count() {
+        return running_jobs.load();
+    }
+
+    // Stops handing out tiles; tiles in flight still complete.
+    void cancel() {
+        cancel_requested = true;
+    }
+
+    State get_state() const {
+        return state.load();
+    }
+
+    const std::string& get_label() const {
+        return label;
+    }
+
+    int get_width() const { return camera.get_image_width(); }
+    int get_height() const { return camera.get_image_height(); }
+
+    // True for jobs that keep their frame in memory and can be presented.
+    bool has_preview() const {
+        return !output;
+    }
+
+    // File a streaming job writes to, empty otherwise.
+    std::string get_output_path() const {
+        return output ? output->get_path() : std::string();
+    }
+
+    // Number of rows a streaming job keeps in memory for an image 'width' pixels
+    // wide: whole rows of tiles, within 'max_band_bytes' where possible.
+    static int band_height_for(int width, int tile_size) {
+        size_t rows = max_band_bytes / (static_cast<size_t>(width) * sizeof(Uint32));
+        return tile_size * std::max(static_cast<int>(rows) / tile_size, 1);
+    }
+
+    // Fraction of pixels traced, in [0, 1]; includes bands resumed from disk.
+    double get_progress() const {
+        size_t total = static_cast<size_t>(get_width()) * get_height();
+        return total ? static_cast<double>(completed_pixels.load()) / total : 1.0;
+    }
+
+    // Wall time since the job started, frozen once it ends.
+    double get_elapsed_seconds() const {
+        auto end = (get_state() == State::Running) ? std::chrono::steady_clock::now() : end_time.load();
+        return std::chrono::duration<double>(end - start_time).count();
+    }
+
+    // Remaining time extrapolated from the pixel rate so far; negative until
+    // the first tile is done.
+    double get_eta_seconds() const {
+        size_t completed = completed_pixels.load();
+        if (completed <= resumed_pixels) {
+            return -1.0;
+        }
+        size_t total = static_cast<size_t>(get_width()) * get_height();
+        return get_elapsed_seconds() * (total - completed) / (completed - resumed_pixels);
+    }
+
+    // Copies the frame into 'out' if tiles finished since 'seen_version' was
+    // taken, and updates it. Untraced pixels are black.
+    bool copy_frame(FrameBuffer& out, uint64_t& seen_version) const {
+        std::lock_guard<std::mutex> lock(display_mutex);
+        if (seen_version == display_version) {
+            return false;
+        }
+        out.resize(display.width, display.height);
+        out.pixels = display.pixels;
+        out.render_ms = get_elapsed_seconds() * 1000.0;
+        seen_version = display_version;
+        return true;
+    }
+
+private:
+    void run() {
+        try {
+            if (output) {
+                run_streaming();
+            }
+            else {
+                run_in_memory();
+            }
+            state = cancel_requested ? State::Cancelled : State::Finished;
+        }
+        catch (const std::exception& e) {
+            std::cerr << label << " failed: " << e.what() << std::endl;
+            state = State::Failed;
+        }
+        end_time = std::chrono::steady_clock::now();
+        --running_jobs;
+
+        if (get_state() != State::Failed) {
+            std::cout << label << ": " << get_width() << "x" << get_height()
+                << (cancel_requested ? " | Cancelled after " : " | Render Time: ")
+                << get_elapsed_seconds() << " seconds" << std::endl;
+        }
+    }
+
+    void run_in_memory() {
+        const int width = frame.width;
+        const int height = frame.height;
+
+        scheduler.run(width, height, camera.get_tile_size(), [&](const Tile& tile) {
+            if (cancel_requested) {
+                return;
+            }
+            camera.render_tile(*scene, tile, frame.data(), samples_per_pixel, enable_antialias,
+                denoise ? &guides : nullptr, denoise ? &radiance : nullptr);
+
+            std::lock_guard<std::mutex> lock(display_mutex);
+            const size_t row_bytes = static_cast<size_t>(tile.x1 - tile.x0) * sizeof(Uint32);
+            for (int row = tile.y0; row < tile.y1; ++row) {
+                size_t offset = static_cast<size_t>(row) * width + tile.x0;
+                std::memcpy(display.pixels.data() + offset, frame.pixels.data() + offset, row_bytes);
+            }
+            completed_pixels += static_cast<size_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+            ++display_version;
+        });
+
+        if (denoise && !cancel_requested) {
+            denoiser.apply(radiance, guides, frame);
+            std::lock_guard<std::mutex> lock(display_mutex);
+            display.pixels = frame.pixels;
+            ++display_version;
+        }
+    }
+
+    // Traces the bands the writer does not have yet, top to bottom. The tiles of
+    // one band are spread over the pool as usual; a band is written once all of
+    // them are done, and a cancelled band is dropped.
+    void run_streaming() {
+        const int width = camera.get_image_width();
+        std::vector<Uint32> band_pixels(static_cast<size_t>(width) * output->get_band_height());
+
+        for (int band = 0; band < output->band_count() && !cancel_requested; ++band) {
+            if (output->is_band_done(band)) {
+                continue;
+            }
+            const int first_row = band * output->get_band_height();
+
+            scheduler.run(width, output->band_rows(band), camera.get_tile_size(), [&](const Tile& band_tile) {
+                if (cancel_requested) {
+                    return;
+                }
+                Tile tile = band_tile;
+                tile.y0 += first_row;
+                tile.y1 += first_row;
+                camera.render_tile(*scene, tile, band_pixels.data(), samples_per_pixel, enable_antialias, nullptr, nullptr, first_row);
+                completed_pixels += static_cast<size_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+            });
+
+            if (!cancel_requested) {
+                output->write_band(band, band_pixels.data());
+            }
+        }
+    }
+
+    static constexpr size_t max_band_bytes = size_t(32) << 20;
+
+    inline static std::atomic<int> running_jobs{ 0 };
+
+    const Camera camera;
+    const std::unique_ptr<SceneManager> scene;
+    const int samples_per_pixel;
+    const bool enable_antialias;
+    const bool denoise;
+    const std::string label;
+
+    const std::chrono::steady_clock::time_point start_time;
+    std::atomic<std::chrono::steady_clock::time_point> end_time{};
+    std::atomic<State> state{ State::Running };
+    std::atomic<bool> cancel_requested{ false };
+    std::atomic<size_t> completed_pixels{ 0 };
+    size_t resumed_pixels = 0;   // Already on disk when a streaming job started
+
+    TileScheduler scheduler;
+    FrameBuffer frame;       // Traced by the tiles, owned by the job thread
+    GBuffer guides;          // Denoiser inputs
+    std::vector<color> radiance;
+    Denoiser denoiser;
+
+    mutable std::mutex display_mutex;
+    FrameBuffer display;     // Finished tiles only
+    uint64_t display_version = 0;
+
+    std::unique_ptr<StreamingImageWriter> output;   // Set for streaming jobs
+
+    std::thread worker;
+};
+
+// Final renders started from the UI, oldest first. Owned by the UI thread.
+struct RenderJobList {
+    std::vector<std::unique_ptr<RenderJob>> jobs;
+    const RenderJob* shown = nullptr;   // Presented in the viewport instead of the preview
+
+    void start(const Camera& camera, const SceneManager& world, int samples_per_pixel, bool enable_antialias, bool denoise, const std::string& label) {
+        jobs.push_back(std::make_unique<RenderJob>(camera, world.snapshot(), samples_per_pixel, enable_antialias, denoise, label));
+        shown = jobs.back().get();
+    }
+
+    // Starts a job that streams to 'path' in bands (see StreamingImageWriter),
+    // picking up the bands of an earlier, interrupted render when 'resume' is
+    // set. Reports and returns false if the file cannot be created.
+    bool start_streaming(const Camera& camera, const SceneManager& world, int samples_per_pixel, bool enable_antialias, const std::string& path, bool resume, const std::string& label) {
+        std::unique_ptr<StreamingImageWriter> output;
+        try {
+            int band_height = RenderJob::band_height_for(camera.get_image_width(), camera.get_tile_size());
+            output = std::make_unique<StreamingImageWriter>(path, camera.get_image_width(), camera.get_image_height(), band_height, resume);
+        }
+        catch (const std::exception& e) {
+            std::cerr << label << ": " << e.what() << std::endl;
+            return false;
+        }
+        jobs.push_back(std::make_unique<RenderJob>(camera, world.snapshot(), samples_per_pixel, enable_antialias, std::move(output), label));
+        return true;
+    }
+
+    void remove(const RenderJob* job) {
+        if (shown == job) {
+            shown = nullptr;
+        }
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+            [job](const std::unique_ptr<RenderJob>& entry) { return entry.get() == job; }), jobs.end());
+    }
+};
+
+#endif // RENDER_JOB_H
@@ -1,10 +1,15 @@
 #ifndef RENDER_STATE_H
 #define RENDER_STATE_H
 
+#include <string>
+
+#include "resolution_controller.h"
+
 enum RenderMode {
     DefaultRender,
     HighResolution,
     LowResolution,
+    DiskRender,
     Disabled
 };
 
@@ -33,9 +38,130 @@ public:
         return current_mode == mode;
     }
 
+    // Asks the main loop to blank the presented frame.
+    void request_clear() {
+        clear_requested = true;
+    }
+
+    bool consume_clear_request() {
+        bool requested = clear_requested;
+        clear_requested = false;
+        return requested;
+    }
+
+    // Shading resolution divisor for the interactive mode; 1 disables guided upscaling.
+    int get_upscale_factor() const {
+        return upscale_factor;
+    }
+
+    void set_upscale_factor(int factor) {
+        upscale_factor = (factor < 1) ? 1 : factor;
+    }
+
+    // Filters single frames so they can be traced with fewer samples.
+    bool is_denoise_enabled() const {
+        return denoise_enabled;
+    }
+
+    void set_denoise_enabled(bool enabled) {
+        denoise_enabled = enabled;
+    }
+
+    // Reuses the previous frame by reprojection while the camera moves.
+    bool is_temporal_enabled() const {
+        return temporal_enabled;
+    }
+
+    void set_temporal_enabled(bool enabled) {
+        temporal_enabled = enabled;
+    }
+
+    // Keeps the primary hits of the preview so light and material edits only
+    // re-run shading.
+    bool is_relight_enabled() const {
+        return relight_enabled;
+    }
+
+    void set_relight_enabled(bool enabled) {
+        relight_enabled = enabled;
+    }
+
+    // Traces full-resolution preview frames breadth-first with sorted ray
+    // queues instead of tile by tile.
+    bool is_wavefront_enabled() const {
+        return wavefront_enabled;
+    }
+
+    void set_wavefront_enabled(bool enabled) {
+        wavefront_enabled = enabled;
+    }
+
+    // Answers most shadow tests of the preview from visibility maps traced in
+    // the background while the scene stays unchanged.
+    bool is_shadow_cache_enabled() const {
+        return shadow_cache_enabled;
+    }
+
+    void set_shadow_cache_enabled(bool enabled) {
+        shadow_cache_enabled = enabled;
+    }
+
+    // Finds the preview's primary hits on meshes and boxes with a rasterizer,
+    // ray casting only the other objects.
+    bool is_raster_primary_enabled() const {
+        return raster_primary_enabled;
+    }
+
+    void set_raster_primary_enabled(bool enabled) {
+        raster_primary_enabled = enabled;
+    }
+
+    // Very large renders streamed to an image file in bands (DiskRender).
+    int get_disk_render_width() const {
+        return disk_render_width;
+    }
+
+    void set_disk_render_width(int width) {
+        disk_render_width = (width < 128) ? 128 : width;
+    }
+
+    const std::string& get_disk_render_path() const {
+        return disk_render_path;
+    }
+
+    void set_disk_render_path(const std::string& path) {
+        disk_render_path = path;
+    }
+
+    // Continue an interrupted render of the same file instead of starting over.
+    bool is_disk_render_resume_enabled() const {
+        return disk_render_resume;
+    }
+
+    void set_disk_render_resume_enabled(bool enabled) {
+        disk_render_resume = enabled;
+    }
+
+    // Internal resolution control for the interactive mode.
+    ResolutionController& resolution() {
+        return resolution_controller;
+    }
+
 private:
     RenderMode current_mode;
     RenderMode previous_mode;
+    bool clear_requested = false;
+    int upscale_factor = 2;
+    bool denoise_enabled = false;
+    bool temporal_enabled = true;
+    bool relight_enabled = true;
+    bool wavefront_enabled = false;
+    bool shadow_cache_enabled = false;
+    bool raster_primary_enabled = false;
+    int disk_render_width = 8192;
+    std::string disk_render_path = "render.ppm";
+    bool disk_render_resume = true;
+    ResolutionController resolution_controller;
 };
 
 #endif // RENDER_STATE_H
@@ -0,0 +1,370 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "camera.h"
+#include "denoiser.h"
+#include "dirty_region.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "guided_upscaler.h"
+#include "hit_cache.h"
+#include "render_gate.h"
+#include "render_job.h"
+#include "scene.h"
+#include "screen_region.h"
+#include "primary_raster.h"
+#include "shadow_cache.h"
+#include "task_pool.h"
+#include "temporal_cache.h"
+#include "wavefront_renderer.h"
+
+// A frame the UI asks the render thread to produce. The camera is copied, so
+// later UI-side camera changes do not affect a frame already in flight.
+struct RenderRequest {
+    Camera camera;
+    int samples_per_pixel = 1;
+    bool antialias = false;
+    bool continuous = true;   // Keep re-rendering until a new request arrives
+    std::string label;        // When set, the render time is logged under this name
+    int upscale_factor = 1;   // > 1 shades at 1/factor resolution and upsamples with guides
+    bool denoise = false;     // Filter the traced frame; ignored when upscaling
+    bool temporal = false;    // Keep this frame as history for reprojection
+    bool reproject = false;   // Reuse the history instead of shading every pixel
+    bool relight = false;     // Keep primary hits to re-shade after light or material edits
+    bool wavefront = false;   // Trace full-resolution frames bounce by bounce (WavefrontRenderer)
+    bool shadow_cache = false; // Answer shadow tests from precomputed maps where possible (ShadowCache)
+    bool raster_primary = false; // Rasterize mesh and box triangles for the camera rays (PrimaryRaster)
+};
+
+// Runs Camera::render on a dedicated worker so the SDL/ImGui loop never waits
+// for a frame. Frames are triple-buffered: the worker writes the back buffer,
+// publishes it as "ready", and the UI swaps the ready buffer to the front when
+// it presents. Camera changes are forwarded as requests; scene edits from the
+// UI go through gate(), which pauses tracing at tile boundaries.
+// While a continuous request keeps the same view, the last frame is reused:
+// only the screen region affected by scene edits since then is traced again
+// (see DirtyRegion), and nothing at all when the scene did not change. With
+// 'relight' set, the primary hits of the frame are kept as well, and edits
+// that leave the geometry alone are shaded from them without camera rays.
+// With 'shadow_cache' set, a ShadowCache of the current scene is kept and
+// rebuilt in the background after object and light edits. With
+// 'raster_primary' set, frames traced tile by tile take the primary hits of
+// triangle geometry from a PrimaryRaster drawn before them.
+class RenderThread {
+public:
+    explicit RenderThread(const SceneManager& world)
+        : world(world), worker(&RenderThread::run, this) {
+    }
+
+    ~RenderThread() {
+        stop();
+    }
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // Replaces any pending request. Continuous requests keep the worker busy;
+    // one-shot requests are consumed by the next frame.
+    void submit(const RenderRequest& request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = request;
+            ++submissions;
+        }
+        cv.notify_all();
+    }
+
+    // Stops continuous rendering once the current frame completes. Pending
+    // one-shot requests are left alone.
+    void pause() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending && pending->continuous) {
+            pending.reset();
+        }
+    }
+
+    // The buffer returned by the last acquire_frame(), for the UI thread only.
+    const FrameBuffer& presented_frame() const {
+        return buffers[front];
+    }
+
+    // Blanks the presented image and drops frames that were started before the call.
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++clear_generation;
+        ready_fresh = false;
+        buffers[front].clear();
+    }
+
+    // Swaps in the most recent completed frame, if there is one, and returns the
+    // buffer the UI should present. It stays valid until the next call.
+    const FrameBuffer& acquire_frame() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ready_fresh) {
+            std::swap(front, ready);
+            ready_fresh = false;
+        }
+        return buffers[front];
+    }
+
+    RenderGate& gate() {
+        return render_gate;
+    }
+
+private:
+    void run() {
+        uint64_t next_frame_id = 1;
+
+        while (true) {
+            std::optional<RenderRequest> request;
+            uint64_t generation;
+            uint64_t seen_submissions;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || pending.has_value(); });
+                if (stopping) {
+                    return;
+                }
+                request = pending;
+                if (!pending->continuous) {
+                    pending.reset();
+                }
+                generation = clear_generation;
+                seen_submissions = submissions;
+            }
+
+            // Scene edits since the last frame, read while no edit is in progress
+            ScreenRegion dirty = ScreenRegion::full();
+            bool shading_only = false;
+            uint64_t revision;
+            {
+                RenderGate::TileScope scope(&render_gate);
+                revision = world.get_revision();
+                if (request->shadow_cache && request->camera.shadowStatus()) {
+                    shadow_cache.update(world);
+                    request->camera.set_shadow_cache(&shadow_cache);
+                }
+                else {
+                    shadow_cache.reset();
+                }
+                if (can_update(*request, generation)) {
+                    SceneChanges changes = world.changes_since(last_revision);
+                    dirty = DirtyRegion::from_changes(request->camera, world, changes);
+                    shading_only = !changes.geometry;
+                }
+                if (request->raster_primary && !request->wavefront && request->upscale_factor <= 1 && !dirty.is_empty()) {
+                    primary_raster.rasterize(request->camera.raster_view(), world);
+                    request->camera.set_primary_raster(&primary_raster);
+                }
+                else {
+                    primary_raster.reset();
+                }
+            }
+
+            if (dirty.is_empty()) {
+                // The last frame is still exact; wait for the next request or edit
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] {
+                    return stopping || submissions != seen_submissions || clear_generation != generation;
+                });
+                continue;
+            }
+
+            // Final render jobs take precedence over the preview for pool workers
+            TaskPool::LaneScope lane(RenderJob::running_count() > 0 ? TaskLane::Background : TaskLane::Interactive);
+
+            FrameBuffer& target = buffers[back];
+            const ScreenRegion* region = nullptr;
+            if (!dirty.covers_everything() && dirty.coverage() <= max_dirty_coverage) {
+                std::lock_guard<std::mutex> lock(mutex);
+                const FrameBuffer& source = buffers[ready_fresh ? ready : front];
+                // A frame of another size cannot be patched: resizing the target
+                // would clear it, leaving everything outside the region black
+                if (source.width == request->camera.get_image_width() && source.height == request->camera.get_image_height()) {
+                    region = &dirty;
+                    target.width = source.width;
+                    target.height = source.height;
+                    target.pixels = source.pixels;
+                }
+            }
+
+            target.path_stats = PathStats();
+            auto start = std::chrono::steady_clock::now();
+            const bool reprojected = request->reproject && temporal_cache.has_history();
+            const GBuffer* frame_guides = &plain_guides;
+            if (reprojected) {
+                // Records its own result as the next history
+                temporal_cache.render(request->camera, world, target, &render_gate);
+                frame_guides = &temporal_cache.frame_guides();
+            }
+            else {
+                // The hits kept by the last frame are still those of this view
+                HitCache* hits = keeps_hits(*request) ? &hit_cache : nullptr;
+                const bool relight = hits && shading_only;
+
+                if (request->upscale_factor > 1) {
+                    if (relight) {
+                        upscaler.relight(request->camera, world, target, request->upscale_factor, hit_cache, &render_gate, region);
+                    }
+                    else {
+                        upscaler.render(request->camera, world, target, request->upscale_factor,
+                            request->samples_per_pixel, request->antialias, &render_gate, region, hits);
+                    }
+                    frame_guides = &upscaler.output_guides();
+                }
+                else if (request->denoise) {
+                    request->camera.render(world, target, request->samples_per_pixel, request->antialias, &render_gate,
+                        &denoise_guides, &denoise_radiance, &tile_scheduler);
+                    denoiser.apply(denoise_radiance, denoise_guides, target);
+                    frame_guides = &denoise_guides;
+                }
+                else if (relight) {
+                    request->camera.relight(world, target, hit_cache, &render_gate, &tile_scheduler, region);
+                }
+                else if (request->wavefront) {
+                    wavefront.render(request->camera, world, target, request->samples_per_pixel, request->antialias,
+                        &render_gate, &plain_guides, region, hits);
+                }
+                else {
+                    request->camera.render(world, target, request->samples_per_pixel, request->antialias, &render_gate,
+                        &plain_guides, nullptr, &tile_scheduler, region, hits);
+                }
+
+                if (request->temporal) {
+                    temporal_cache.record(request->camera, *frame_guides, target);
+                }
+                else {
+                    temporal_cache.invalidate();
+                }
+            }
+            publish_aovs(*frame_guides, target);
+            auto end = std::chrono::steady_clock::now();
+
+            target.render_ms = std::chrono::duration<double, std::milli>(end - start).count();
+            target.frame_id = next_frame_id++;
+
+            if (!request->label.empty()) {
+                std::cout << request->label << ": "
+                    << target.width << "x" << target.height
+                    << " | Render Time: " << target.render_ms / 1000.0 << " seconds" << std::endl;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (generation == clear_generation) {
+                std::swap(back, ready);
+                ready_fresh = true;
+                last_request = request;
+                last_exact = !reprojected;
+                last_generation = generation;
+                last_revision = revision;
+            }
+            else {
+                last_request.reset();
+            }
+        }
+    }
+
+    // True if the last published frame is an exact render of 'request' as of
+    // 'last_revision', so that it only needs the scene edits made since.
+    bool can_update(const RenderRequest& request, uint64_t generation) const {
+        return last_request && last_exact && last_generation == generation &&
+            request.continuous && !request.reproject && !request.denoise &&
+            request.samples_per_pixel == last_request->samples_per_pixel &&
+            request.antialias == last_request->antialias &&
+            request.upscale_factor == last_request->upscale_factor &&
+            request.temporal == last_request->temporal &&
+            request.relight == last_request->relight &&
+            request.wavefront == last_request->wavefront &&
+            request.shadow_cache == last_request->shadow_cache &&
+            request.raster_primary == last_request->raster_primary &&
+            request.camera.same_view(last_request->camera);
+    }
+
+    // Copies depth, normal and ObjectID of every pixel next to the colors, for
+    // picking and overlays on the UI side.
+    static void publish_aovs(const GBuffer& guides, FrameBuffer& target) {
+        if (guides.width != target.width || guides.height != target.height) {
+            target.aovs.clear();
+            return;
+        }
+        FrameAOVs& aovs = target.aovs;
+        aovs.resize(guides.width, guides.height);
+        for (size_t i = 0; i < guides.samples.size(); ++i) {
+            const GBufferSample& sample = guides.samples[i];
+            aovs.depth[i] = sample.depth;
+            for (int k = 0; k < 3; ++k) {
+                aovs.normal[3 * i + k] = sample.normal[k];
+            }
+            aovs.object_id[i] = sample.hit ? sample.object_id : GBufferSample::no_object;
+        }
+    }
+
+    // Frames whose primary hits are kept for relighting. Antialiased frames
+    // average jittered rays, so one cached hit per pixel cannot reproduce them.
+    static bool keeps_hits(const RenderRequest& request) {
+        return request.relight && !request.antialias && !request.denoise;
+    }
+
+    // Above this fraction of the screen a full frame is traced instead
+    static constexpr double max_dirty_coverage = 0.6;
+
+    const SceneManager& world;
+    RenderGate render_gate;
+
+    // Used by the worker only
+    TileScheduler tile_scheduler;
+    GuidedUpscaler upscaler;
+    WavefrontRenderer wavefront;
+    Denoiser denoiser;
+    GBuffer denoise_guides;
+    std::vector<color> denoise_radiance;
+    TemporalCache temporal_cache;
+    GBuffer plain_guides;
+    HitCache hit_cache;
+    ShadowCache shadow_cache;
+    PrimaryRaster primary_raster;
+
+    // The last published frame, for reuse
+    std::optional<RenderRequest> last_request;
+    bool last_exact = false;      // Not reprojected
+    uint64_t last_generation = 0;
+    uint64_t last_revision = 0;   // Scene revision read before it was traced
+
+    std::array<FrameBuffer, 3> buffers;
+    int back = 0;        // Owned by the worker
+    int ready = 1;       // Latest completed frame
+    int front = 2;       // Owned by the UI
+    bool ready_fresh = false;
+    uint64_t clear_generation = 0;
+    uint64_t submissions = 0;
+
+    std::optional<RenderRequest> pending;
+    bool stopping = false;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread worker;  // Declared last so it starts after every other member
+};
+
+#endif // RENDER_THREAD_H
@@ -0,0 +1,113 @@
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "camera.h"
+
+// Picks the internal render width for the interactive mode. While the camera
+// moves, frames are traced at a fraction of the full width chosen so the trace
+// time meets the target frame rate; once the camera has been still for a short
+// moment the full width is used again to refine the image. The presented frame
+// is upsampled to the window by the SDL texture copy.
+class ResolutionController {
+public:
+    ResolutionController(double target_fps = 30.0, double min_scale = 0.25)
+        : target_fps(target_fps), min_scale(min_scale), scale(1.0) {
+    }
+
+    void set_enabled(bool value) { enabled = value; }
+    bool is_enabled() const { return enabled; }
+
+    void set_target_fps(double fps) { target_fps = std::max(1.0, fps); }
+    double get_target_fps() const { return target_fps; }
+
+    void set_min_scale(double value) { min_scale = std::clamp(value, 0.05, 1.0); scale = std::max(scale, min_scale); }
+    double get_min_scale() const { return min_scale; }
+
+    // Current scale used while the camera moves (1.0 = full resolution).
+    double get_scale() const { return scale; }
+
+    bool is_moving() const { return moving; }
+
+    // Compares the camera against the last one seen and updates the motion state.
+    // The camera counts as still only after 'settle_ms' without changes, so key
+    // repeats do not bounce between low and full resolution.
+    void update_motion(const Camera& camera) {
+        auto now = std::chrono::steady_clock::now();
+        bool changed = !has_last_camera ||
+            camera.get_origin() != last_origin ||
+            camera.get_look_at() != last_look_at ||
+            camera.get_up() != last_up ||
+            camera.get_fov_degrees() != last_fov ||
+            camera.get_ortho_scale() != last_ortho_scale;
+
+        if (changed) {
+            last_origin = camera.get_origin();
+            last_look_at = camera.get_look_at();
+            last_up = camera.get_up();
+            last_fov = camera.get_fov_degrees();
+            last_ortho_scale = camera.get_ortho_scale();
+            last_change = now;
+            moving = has_last_camera;
+            has_last_camera = true;
+            return;
+        }
+
+        double still_ms = std::chrono::duration<double, std::milli>(now - last_change).count();
+        if (still_ms >= settle_ms) {
+            moving = false;
+        }
+    }
+
+    // Width to trace at for the given full width.
+    int width_for(int full_width) const {
+        if (!enabled || !moving) {
+            return full_width;
+        }
+        // Camera::set_image_width rejects widths of 100 or less
+        int width = static_cast<int>(std::lround(full_width * scale));
+        return std::clamp(width, std::min(full_width, 128), full_width);
+    }
+
+    // Feeds back the trace time of a completed interactive frame. Trace cost is
+    // roughly proportional to the pixel count, so the scale that would have met
+    // the budget is frame_scale * sqrt(budget / time). The result is smoothed
+    // and only applied outside a small dead band to avoid oscillation.
+    void frame_completed(double render_ms, int frame_width, int full_width) {
+        if (render_ms <= 0.0 || frame_width <= 0 || full_width <= 0) {
+            return;
+        }
+
+        double frame_scale = static_cast<double>(frame_width) / full_width;
+        double budget_ms = 1000.0 / target_fps;
+        double ratio = budget_ms / render_ms;
+
+        if (ratio > 0.85 && ratio < 1.15) {
+            return;
+        }
+
+        double desired = std::clamp(frame_scale * std::sqrt(ratio), min_scale, 1.0);
+        scale = std::clamp(scale + (desired - scale) * 0.5, min_scale, 1.0);
+    }
+
+private:
+    bool enabled = true;
+    double target_fps;
+    double min_scale;
+    double scale;
+    double settle_ms = 200.0;
+
+    bool moving = false;
+    bool has_last_camera = false;
+    std::chrono::steady_clock::time_point last_change;
+    point3 last_origin;
+    point3 last_look_at;
+    vec3 last_up;
+    double last_fov = 0.0;
+    double last_ortho_scale = 0.0;
+};
+
+#endif // RESOLUTION_CONTROLLER_H
@@ -0,0 +1,137 @@
+#ifndef SCREEN_REGION_H
+#define SCREEN_REGION_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// Set of screen rectangles in normalized coordinates (x to the right, y down,
+// both in [0, 1]), so one region applies to an image at any resolution.
+// Pixel queries round outwards and take a margin, which makes them
+// conservative.
+class ScreenRegion {
+public:
+    struct Rect {
+        double x0, y0, x1, y1;
+    };
+
+    static ScreenRegion full() {
+        ScreenRegion region;
+        region.everything = true;
+        return region;
+    }
+
+    bool is_empty() const {
+        return !everything && rects.empty();
+    }
+
+    bool covers_everything() const {
+        return everything;
+    }
+
+    void set_everything() {
+        everything = true;
+        rects.clear();
+    }
+
+    // Adds a rectangle; the part outside the screen is dropped.
+    void add(Rect rect) {
+        if (everything) {
+            return;
+        }
+        rect.x0 = std::max(rect.x0, 0.0);
+        rect.y0 = std::max(rect.y0, 0.0);
+        rect.x1 = std::min(rect.x1, 1.0);
+        rect.y1 = std::min(rect.y1, 1.0);
+        if (rect.x0 < rect.x1 && rect.y0 < rect.y1) {
+            rects.push_back(rect);
+        }
+    }
+
+    // Copy with every rectangle grown by 'dx' and 'dy' on each side.
+    ScreenRegion grown(double dx, double dy) const {
+        ScreenRegion region;
+        region.everything = everything;
+        for (const Rect& rect : rects) {
+            region.add({ rect.x0 - dx, rect.y0 - dy, rect.x1 + dx, rect.y1 + dy });
+        }
+        return region;
+    }
+
+    // Upper bound of the fraction of the screen covered, counted on a coarse
+    // grid so overlapping rectangles are not counted twice.
+    double coverage() const {
+        if (everything) {
+            return 1.0;
+        }
+        constexpr int cells = 64;
+        std::vector<bool> covered(cells * cells, false);
+        for (const Rect& rect : rects) {
+            int x0, y0, x1, y1;
+            to_pixels(rect, cells, cells, 0, x0, y0, x1, y1);
+            for (int y = y0; y < y1; ++y) {
+                std::fill(covered.begin() + y * cells + x0, covered.begin() + y * cells + x1, true);
+            }
+        }
+        return static_cast<double>(std::count(covered.begin(), covered.end(), true)) / (cells * cells);
+    }
+
+    // True if the pixels [x0, x1) x [y0, y1) of a width x height image, grown
+    // by 'margin' pixels, touch the region.
+    bool overlaps(int x0, int y0, int x1, int y1, int width, int height, int margin = 1) const {
+        if (everything) {
+            return true;
+        }
+        for (const Rect& rect : rects) {
+            int rx0, ry0, rx1, ry1;
+            to_pixels(rect, width, height, margin, rx0, ry0, rx1, ry1);
+            if (rx0 < x1 && x0 < rx1 && ry0 < y1 && y0 < ry1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Pixel spans [first, last) of row 'y' that touch the region (grown by
+    // 'margin' pixels), sorted and without overlaps.
+    void row_spans(int y, int width, int height, int margin, std::vector<std::pair<int, int>>& spans) const {
+        spans.clear();
+        if (everything) {
+            spans.emplace_back(0, width);
+            return;
+        }
+        for (const Rect& rect : rects) {
+            int rx0, ry0, rx1, ry1;
+            to_pixels(rect, width, height, margin, rx0, ry0, rx1, ry1);
+            if (ry0 <= y && y < ry1 && rx0 < rx1) {
+                spans.emplace_back(rx0, rx1);
+            }
+        }
+        std::sort(spans.begin(), spans.end());
+
+        size_t merged = 0;
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if (merged > 0 && spans[i].first <= spans[merged - 1].second) {
+                spans[merged - 1].second = std::max(spans[merged - 1].second, spans[i].second);
+            }
+            else {
+                spans[merged++] = spans[i];
+            }
+        }
+        spans.resize(merged);
+    }
+
+private:
+    static void to_pixels(const Rect& rect, int width, int height, int margin, int& x0, int& y0, int& x1, int& y1) {
+        x0 = std::max(static_cast<int>(std::floor(rect.x0 * width)) - margin, 0);
+        y0 = std::max(static_cast<int>(std::floor(rect.y0 * height)) - margin, 0);
+        x1 = std::min(static_cast<int>(std::ceil(rect.x1 * width)) + margin, width);
+        y1 = std::min(static_cast<int>(std::ceil(rect.y1 * height)) + margin, height);
+    }
+
+    bool everything = false;
+    std::vector<Rect> rects;
+};
+
+#endif // SCREEN_REGION_H
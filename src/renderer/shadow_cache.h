@@ -0,0 +1,346 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "light.h"
+#include "ray.h"
+#include "scene.h"
+#include "task_pool.h"
+#include "vec3.h"
+
+// Light visibility of a static scene, traced once in the background so that
+// shading can skip most shadow rays. Each light gets a map of the distance to
+// the first surface its rays hit: an orthographic map over the scene bounds
+// for directional lights, a cube map around point and spot lights. A point is
+// lit when the four texel rays around it reach its tangent plane, or its
+// distance, before hitting anything, and shadowed when all four are blocked
+// in front of both. Near shadow edges the rays disagree and lookup() answers
+// Unknown, so the caller traces the exact ray. Occluders, or gaps between
+// them, smaller than a texel can be missed.
+// The render thread calls update() between frames: it starts a build on a
+// snapshot once the scene has stayed the same for a frame, installs the maps
+// if no object or light changed meanwhile, and drops them on the first such
+// change. Material edits keep them.
+class ShadowCache {
+public:
+    enum class Visibility { Unknown, Lit, Shadowed };
+
+    static constexpr int directional_resolution = 1024;
+    static constexpr int cube_resolution = 384;        // Per face
+    static constexpr size_t max_lights = 16;           // Later lights always trace rays
+
+    ShadowCache() = default;
+
+    ~ShadowCache() {
+        reset();
+    }
+
+    ShadowCache(const ShadowCache&) = delete;
+    ShadowCache& operator=(const ShadowCache&) = delete;
+
+    // Brings the maps up to date with 'world', which must not be edited during
+    // the call. Lookups must not run concurrently.
+    void update(const SceneManager& world) {
+        const uint64_t revision = world.get_revision();
+        if (ready) {
+            if (keeps_visibility(world.changes_since(maps_revision))) {
+                maps_revision = revision;
+            }
+            else {
+                drop_maps();
+            }
+        }
+
+        if (builder.joinable()) {
+            if (build_done) {
+                builder.join();
+                if (!build_cancelled && keeps_visibility(world.changes_since(build_revision))) {
+                    install(world, revision);
+                }
+                built_maps.clear();
+            }
+            else if (!keeps_visibility(world.changes_since(build_revision))) {
+                build_cancelled = true;   // Joined by a later call
+            }
+        }
+
+        if (!ready && !builder.joinable() && revision == last_revision) {
+            build_revision = revision;
+            build_done = false;
+            build_cancelled = false;
+            builder = std::thread(&ShadowCache::build, this, world.snapshot());
+        }
+        last_revision = revision;
+    }
+
+    // Stops any build and frees the maps.
+    void reset() {
+        build_cancelled = true;
+        if (builder.joinable()) {
+            builder.join();
+        }
+        built_maps.clear();
+        drop_maps();
+    }
+
+    bool is_ready() const {
+        return ready;
+    }
+
+    // Visibility of 'light' from 'p' on a surface facing it with 'normal';
+    // Unknown when the light has no map or the map cannot tell.
+    Visibility lookup(const Light& light, const point3& p, const vec3& normal) const {
+        if (!ready) {
+            return Visibility::Unknown;
+        }
+        auto it = light_maps.find(&light);
+        return it == light_maps.end() ? Visibility::Unknown : it->second->lookup(p, normal);
+    }
+
+private:
+    class DepthMap {
+    public:
+        // Orthographic map looking along 'direction' over 'bounds'
+        DepthMap(const vec3& direction, const point3& bounds_min, const point3& bounds_max, int resolution)
+            : resolution(resolution), faces(1), axis_w(unit_vector(direction)) {
+            vec3 helper = std::fabs(axis_w.x()) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0);
+            axis_u = unit_vector(cross(helper, axis_w));
+            axis_v = cross(axis_w, axis_u);
+
+            const double inf = std::numeric_limits<double>::infinity();
+            double u_min = inf, u_max = -inf, v_min = inf, v_max = -inf, w_min = inf;
+            for (int corner = 0; corner < 8; ++corner) {
+                point3 p((corner & 1) ? bounds_max.x() : bounds_min.x(),
+                    (corner & 2) ? bounds_max.y() : bounds_min.y(),
+                    (corner & 4) ? bounds_max.z() : bounds_min.z());
+                u_min = std::min<double>(u_min, dot(p, axis_u));
+                u_max = std::max<double>(u_max, dot(p, axis_u));
+                v_min = std::min<double>(v_min, dot(p, axis_v));
+                v_max = std::max<double>(v_max, dot(p, axis_v));
+                w_min = std::min<double>(w_min, dot(p, axis_w));
+            }
+            // Square texels; the margin keeps shadows cast just past the objects
+            double extent = std::max({ u_max - u_min, v_max - v_min, 1e-3 }) * (1.0 + 2.0 * margin);
+            texel = extent / resolution;
+            u_origin = 0.5 * (u_min + u_max) - 0.5 * extent;
+            v_origin = 0.5 * (v_min + v_max) - 0.5 * extent;
+            start = w_min - margin * extent;
+            depth.resize(static_cast<size_t>(resolution) * resolution);
+        }
+
+        // Cube map around 'center'
+        DepthMap(const point3& center, int resolution)
+            : resolution(resolution), faces(6), center(center) {
+            depth.resize(static_cast<size_t>(faces) * resolution * resolution);
+        }
+
+        // Traces every texel against 'scene'; returns false if cancelled.
+        bool trace(const SceneManager& scene, const std::atomic<bool>& cancelled) {
+            TaskPool::shared().parallel_for(0, faces * resolution, [&](int row) {
+                if (cancelled) {
+                    return;
+                }
+                const int face = row / resolution;
+                const int j = row % resolution;
+                for (int i = 0; i < resolution; ++i) {
+                    depth[(static_cast<size_t>(face) * resolution + j) * resolution + i] = static_cast<float>(trace_texel(scene, face, i, j));
+                }
+            });
+            return !cancelled;
+        }
+
+        Visibility lookup(const point3& p, const vec3& normal) const {
+            if (faces == 1) {
+                double w = dot(p, axis_w);
+                if (w < start) {
+                    return Visibility::Unknown;
+                }
+                double x = (dot(p, axis_u) - u_origin) / texel - 0.5;
+                double y = (dot(p, axis_v) - v_origin) / texel - 0.5;
+                return classify(0, x, y, p, normal, w, texel);
+            }
+
+            vec3 offset = p - center;
+            double distance = offset.length();
+            int axis = (std::fabs(offset.x()) >= std::fabs(offset.y()) && std::fabs(offset.x()) >= std::fabs(offset.z())) ? 0
+                : (std::fabs(offset.y()) >= std::fabs(offset.z()) ? 1 : 2);
+            double major = std::fabs(offset[axis]);
+            if (!(major > 0.0)) {
+                return Visibility::Unknown;
+            }
+            int face = 2 * axis + (offset[axis] < 0.0 ? 1 : 0);
+            double x = (offset[(axis + 1) % 3] / major + 1.0) * 0.5 * resolution - 0.5;
+            double y = (offset[(axis + 2) % 3] / major + 1.0) * 0.5 * resolution - 0.5;
+            // Texels stretch away from the face center
+            double stretch = distance / major;
+            return classify(face, x, y, p, normal, distance, distance * (2.0 / resolution) * stretch * stretch);
+        }
+
+    private:
+        // Fraction of the scene extent added around the directional maps
+        static constexpr double margin = 0.25;
+
+        // Point at 'distance' along the ray of texel (i, j) of 'face'; for
+        // orthographic maps the distance is measured from the plane through
+        // the origin
+        point3 texel_point(int face, int i, int j, double distance) const {
+            if (faces == 1) {
+                return axis_u * (u_origin + (i + 0.5) * texel) + axis_v * (v_origin + (j + 0.5) * texel) + axis_w * distance;
+            }
+            const int axis = face / 2;
+            vec3 direction(0, 0, 0);
+            direction[axis] = (face % 2 == 0) ? 1.0 : -1.0;
+            direction[(axis + 1) % 3] = (i + 0.5) * 2.0 / resolution - 1.0;
+            direction[(axis + 2) % 3] = (j + 0.5) * 2.0 / resolution - 1.0;
+            return center + unit_vector(direction) * distance;
+        }
+
+        // Distance at which the ray of texel (i, j) first hits 'scene'
+        double trace_texel(const SceneManager& scene, int face, int i, int j) const {
+            const double inf = std::numeric_limits<double>::infinity();
+            hit_record rec;
+            if (faces == 1) {
+                point3 origin = texel_point(face, i, j, start);
+                // Anything towards the light from the map start, such as an
+                // unbounded plane, shadows the whole texel
+                if (scene.hit(ray(origin, -axis_w, ShadowRays), interval(0.0, inf), rec)) {
+                    return start;
+                }
+                return scene.hit(ray(origin, axis_w, ShadowRays), interval(0.0, inf), rec) ? start + rec.t : inf;
+            }
+            return scene.hit(ray(center, texel_point(face, i, j, 1.0) - center, ShadowRays), interval(0.0, inf), rec) ? rec.t : inf;
+        }
+
+        // Checks the four texel rays around (x, y) of 'face' against the
+        // surface at 'p', at 'distance' from the light: the point is lit when
+        // every ray gets past its tangent plane, or past its distance, before
+        // hitting anything, and shadowed when every ray hits something in
+        // front of both. 'size' is the width of a texel at the point.
+        Visibility classify(int face, double x, double y, const point3& p, const vec3& normal, double distance, double size) const {
+            if (!(x >= 0.0 && y >= 0.0 && x < resolution - 1 && y < resolution - 1)) {
+                return Visibility::Unknown;
+            }
+            const int ix = static_cast<int>(x);
+            const int iy = static_cast<int>(y);
+            const double tolerance = 0.05 * size;
+            bool lit = true;
+            bool shadowed = true;
+            for (int k = 0; k < 4; ++k) {
+                const int i = ix + (k & 1);
+                const int j = iy + (k >> 1);
+                const double hit = depth[(static_cast<size_t>(face) * resolution + j) * resolution + i];
+                const bool in_front = hit < distance - tolerance;
+                const bool above = std::isfinite(hit) && dot(texel_point(face, i, j, hit) - p, normal) > tolerance;
+                lit = lit && !(in_front && above);
+                shadowed = shadowed && in_front && above;
+            }
+            return lit ? Visibility::Lit : (shadowed ? Visibility::Shadowed : Visibility::Unknown);
+        }
+
+        int resolution;
+        int faces;                  // 1 for orthographic maps, 6 for cube maps
+        vec3 axis_u, axis_v, axis_w;
+        double u_origin = 0.0, v_origin = 0.0, texel = 0.0, start = 0.0;
+        point3 center;
+        std::vector<float> depth;   // Face by face, rows of 'resolution' texels
+    };
+
+    // Object and light edits change what the lights see; material edits do not
+    static bool keeps_visibility(const SceneChanges& changes) {
+        return !changes.everything && !changes.geometry;
+    }
+
+    // Bounds of the objects, leaving out those too large to map (planes)
+    static bool finite_bounds(const SceneManager& scene, point3& bounds_min, point3& bounds_max) {
+        constexpr double max_extent = 1e5;
+        const double inf = std::numeric_limits<double>::infinity();
+        bounds_min = point3(inf, inf, inf);
+        bounds_max = point3(-inf, -inf, -inf);
+        bool found = false;
+        for (const auto& object : scene.getObjects()) {
+            BoundingBox box = object->bounding_box();
+            bool finite = true;
+            for (int axis = 0; axis < 3; ++axis) {
+                finite = finite && std::isfinite(box.vmin[axis]) && std::isfinite(box.vmax[axis]) &&
+                    box.vmax[axis] - box.vmin[axis] < max_extent;
+            }
+            if (!finite) {
+                continue;
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                bounds_min[axis] = std::min(bounds_min[axis], box.vmin[axis]);
+                bounds_max[axis] = std::max(bounds_max[axis], box.vmax[axis]);
+            }
+            found = true;
+        }
+        return found;
+    }
+
+    // Runs on 'builder'. Maps follow the order of the scene's lights; lights
+    // without a map get a null entry.
+    void build(std::unique_ptr<SceneManager> scene) {
+        TaskPool::LaneScope lane(TaskLane::Background);
+        point3 bounds_min, bounds_max;
+        const bool bounded = finite_bounds(*scene, bounds_min, bounds_max);
+        const auto& lights = scene->get_lights();
+        for (size_t i = 0; i < std::min(lights.size(), max_lights) && !build_cancelled; ++i) {
+            std::unique_ptr<DepthMap> map;
+            if (dynamic_cast<const DirectionalLight*>(lights[i].get())) {
+                if (bounded) {
+                    map = std::make_unique<DepthMap>(-lights[i]->get_light_direction(bounds_min), bounds_min, bounds_max, directional_resolution);
+                }
+            }
+            else {
+                map = std::make_unique<DepthMap>(lights[i]->get_position(), cube_resolution);
+            }
+            if (map && !map->trace(*scene, build_cancelled)) {
+                break;
+            }
+            built_maps.push_back(std::move(map));
+        }
+        build_done = true;
+    }
+
+    // Takes the finished build, whose lights are those of 'world' in order.
+    void install(const SceneManager& world, uint64_t revision) {
+        maps = std::move(built_maps);
+        const auto& lights = world.get_lights();
+        for (size_t i = 0; i < maps.size() && i < lights.size(); ++i) {
+            if (maps[i]) {
+                light_maps[lights[i].get()] = maps[i].get();
+            }
+        }
+        maps_revision = revision;
+        ready = true;
+    }
+
+    void drop_maps() {
+        ready = false;
+        light_maps.clear();
+        maps.clear();
+    }
+
+    // Installed maps, read by lookup()
+    std::vector<std::unique_ptr<DepthMap>> maps;
+    std::unordered_map<const Light*, const DepthMap*> light_maps;
+    bool ready = false;
+    uint64_t maps_revision = 0;     // Revision the maps are known to match
+    uint64_t last_revision = 0;     // Revision seen by the previous update()
+
+    // Build in progress
+    std::thread builder;
+    std::vector<std::unique_ptr<DepthMap>> built_maps;
+    std::atomic<bool> build_done{ false };
+    std::atomic<bool> build_cancelled{ false };
+    uint64_t build_revision = 0;
+};
+
+#endif // SHADOW_CACHE_H
@@ -0,0 +1,171 @@
+#ifndef TEMPORAL_CACHE_H
+#define TEMPORAL_CACHE_H
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "render_gate.h"
+#include "task_pool.h"
+
+// Reuses the previous frame while the camera moves. Every pixel still casts
+// its primary ray, but the hit point is projected into the previous camera and,
+// if the pixel found there saw the same surface point, its color is copied
+// instead of shading again (no shadow rays, no reflections). Disoccluded or
+// mismatching pixels, and points now seen from a noticeably different angle,
+// are shaded fully. Each pixel also carries an age, and
+// reused colors older than 'refresh_interval' frames are re-shaded, so view-
+// dependent highlights and scene edits catch up after a few frames. Ages start
+// staggered, so that refresh is spread evenly instead of happening all at once.
+class TemporalCache {
+public:
+    int refresh_interval = 8;
+
+    bool has_history() const {
+        return history_valid;
+    }
+
+    void invalidate() {
+        history_valid = false;
+    }
+
+    // Guides of the last frame rendered or recorded.
+    const GBuffer& frame_guides() const {
+        return history_guides;
+    }
+
+    // Stores a frame rendered by another path, together with the primary-hit
+    // guides at the same resolution, as the history for the next reprojection.
+    void record(const Camera& camera, const GBuffer& guides, const FrameBuffer& frame) {
+        if (guides.width != frame.width || guides.height != frame.height || frame.empty()) {
+            history_valid = false;
+            return;
+        }
+
+        history_guides = guides;
+        history_colors = frame.pixels;
+        history_age.resize(frame.pixels.size());
+        for (int y = 0; y < frame.height; ++y) {
+            for (int x = 0; x < frame.width; ++x) {
+                history_age[static_cast<size_t>(y) * frame.width + x] = static_cast<uint8_t>((x + 3 * y) % refresh_interval);
+            }
+        }
+        history_camera = camera;
+        history_valid = true;
+    }
+
+    // Renders 'camera' into 'target' reusing the history where possible, then
+    // makes the result the new history. Requires has_history().
+    void render(const Camera& camera, const SceneManager& manager, FrameBuffer& target, RenderGate* gate = nullptr) {
+        const int width = camera.get_image_width();
+        const int height = camera.get_image_height();
+        const Camera& previous = *history_camera;
+        current_origin = camera.get_origin();
+
+        target.resize(width, height);
+        guides.resize(width, height);
+        age.resize(static_cast<size_t>(width) * height);
+        Uint32* pixels = target.data();
+
+        TaskPool::shared().parallel_for(0, height, [&](int y) {
+            RenderGate::TileScope row_scope(gate);
+
+            for (int x = 0; x < width; ++x) {
+                const size_t index = static_cast<size_t>(y) * width + x;
+                ray r = camera.primary_ray(x, y);
+                hit_record rec;
+                bool hit = manager.hit(r, interval(0.001, infinity), rec);
+                color albedo = hit ? rec.material->get_color(rec.u, rec.v) : color(0, 0, 0);
+                Camera::store_guide(manager, guides, x, y, hit ? &rec : nullptr);
+
+                size_t history_index;
+                if (hit && reproject(previous, rec, albedo, history_index)) {
+                    pixels[index] = history_colors[history_index];
+                    age[index] = static_cast<uint8_t>(history_age[history_index] + 1);
+                    continue;
+                }
+
+                // Misses only evaluate the background gradient; hits are shaded fully
+                color pixel_color = camera.shade_primary(manager, r, hit ? &rec : nullptr);
+                write_color(pixels, x, height - 1 - y, width, height, pixel_color);
+                age[index] = 0;
+            }
+        });
+
+        std::swap(history_guides, guides);
+        std::swap(history_age, age);
+        history_colors = target.pixels;
+        history_camera = camera;
+    }
+
+private:
+    // Finds the history pixel that saw the surface point of 'rec'. It must be on
+    // the same object, close to the point and its tangent plane, show the same
+    // surface color, and not be due for a refresh.
+    bool reproject(const Camera& previous, const hit_record& rec, const color& albedo, size_t& history_index) const {
+        double pixel_x, pixel_y;
+        if (!previous.project_to_pixel(rec.p, pixel_x, pixel_y)) {
+            return false;
+        }
+        if (pixel_x < 0.0 || pixel_y < 0.0 || pixel_x >= history_guides.width || pixel_y >= history_guides.height) {
+            return false;
+        }
+
+        int history_x = static_cast<int>(pixel_x);
+        int history_y = static_cast<int>(pixel_y);
+        history_index = static_cast<size_t>(history_y) * history_guides.width + history_x;
+
+        if (history_age[history_index] + 1 >= refresh_interval) {
+            return false;
+        }
+
+        const GBufferSample& sample = history_guides.samples[history_index];
+        if (!sample.hit || sample.object != rec.hit_object) {
+            return false;
+        }
+
+        // Tolerances are relative to the distance, like the pixel footprint
+        vec3 delta = sample.get_position() - rec.p;
+        double tolerance = rec.t;
+        if (delta.length_squared() > (0.05 * tolerance) * (0.05 * tolerance) ||
+            std::fabs(dot(rec.normal, delta)) > 0.005 * tolerance) {
+            return false;
+        }
+
+        if (dot(rec.normal, sample.get_normal()) < 0.9) {
+            return false;
+        }
+
+        // Texture edges: the history pixel may have landed on the other side
+        if ((albedo - sample.get_albedo()).length_squared() > 0.01) {
+            return false;
+        }
+
+        // Shading is view dependent (highlights, and mirrored scenery on reflective
+        // surfaces), so the point must also be seen from nearly the same direction
+        vec3 view = unit_vector(rec.p - current_origin);
+        vec3 previous_view = unit_vector(rec.p - previous.get_origin());
+        double min_cosine = (rec.material && rec.material->reflection > 0.0) ? reflective_view_cosine : view_cosine;
+        return dot(view, previous_view) >= min_cosine;
+    }
+
+    static constexpr double view_cosine = 0.9962;             // ~5 degrees
+    static constexpr double reflective_view_cosine = 0.99985; // ~1 degree
+
+    point3 current_origin;                  // Eye of the frame being rendered
+    std::optional<Camera> history_camera;   // Camera has no default constructor
+    GBuffer history_guides;
+    std::vector<Uint32> history_colors;
+    std::vector<uint8_t> history_age;
+    bool history_valid = false;
+
+    // Scratch for the frame being rendered
+    GBuffer guides;
+    std::vector<uint8_t> age;
+};
+
+#endif // TEMPORAL_CACHE_H
@@ -0,0 +1,78 @@
+#ifndef TILE_FRUSTUM_H
+#define TILE_FRUSTUM_H
+
+#include <cmath>
+#include <type_traits>
+
+#include "boundingbox.h"
+#include "ray.h"
+#include "vec3.h"
+
+// Convex volume holding every camera ray of a screen tile: the four planes
+// through neighbouring corner rays and the plane the rays start from. It is
+// built from the rays themselves, so perspective and orthographic cameras,
+// in world or camera space, are handled alike.
+class TileFrustum {
+public:
+    // 'corners' are the rays through the tile corners, in order around it.
+    explicit TileFrustum(const ray corners[4]) {
+        point3 origin(0, 0, 0);
+        vec3 direction(0, 0, 0);
+        point3 inside(0, 0, 0);
+        for (int i = 0; i < 4; ++i) {
+            origin += corners[i].origin() * 0.25;
+            direction += unit_vector(corners[i].direction()) * 0.25;
+            inside += (corners[i].origin() + corners[i].direction()) * 0.25;
+        }
+        for (int i = 0; i < 4; ++i) {
+            const ray& a = corners[i];
+            const ray& b = corners[(i + 1) % 4];
+            vec3 normal = unit_vector(cross(a.direction(), b.origin() + b.direction() - a.origin()));
+            if (dot(normal, inside - a.origin()) < 0.0) {
+                normal = -normal;
+            }
+            planes[i] = { a.origin(), normal };
+        }
+        planes[4] = { origin, unit_vector(direction) };
+    }
+
+    // True when no ray of the tile can reach 'box': its corner furthest
+    // along some plane's inward normal is still behind that plane.
+    bool excludes(const BoundingBox& box) const {
+        for (const Plane& plane : planes) {
+            point3 corner(plane.normal.x() >= 0.0 ? box.vmax.x() : box.vmin.x(),
+                plane.normal.y() >= 0.0 ? box.vmax.y() : box.vmin.y(),
+                plane.normal.z() >= 0.0 ? box.vmax.z() : box.vmin.z());
+            vec3 offset = corner - plane.point;
+            // Tolerance for rays running along the plane
+            if (dot(plane.normal, offset) < -tolerance * (1.0 + offset.length())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Distance from the rays' start plane to the nearest corner of 'box',
+    // which orders boxes front to back.
+    double depth(const BoundingBox& box) const {
+        const Plane& plane = planes[4];
+        point3 corner(plane.normal.x() >= 0.0 ? box.vmin.x() : box.vmax.x(),
+            plane.normal.y() >= 0.0 ? box.vmin.y() : box.vmax.y(),
+            plane.normal.z() >= 0.0 ? box.vmin.z() : box.vmax.z());
+        return dot(plane.normal, corner - plane.point);
+    }
+
+private:
+    // Relative slack of excludes(), above the rounding of a float dot product
+    static constexpr real tolerance = std::is_same<real, float>::value ? real(1e-5) : real(1e-9);
+
+    // Points x with dot(normal, x - point) >= 0 are inside
+    struct Plane {
+        point3 point;
+        vec3 normal;
+    };
+
+    Plane planes[5];
+};
+
+#endif // TILE_FRUSTUM_H
@@ -0,0 +1,245 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+#include "screen_region.h"
+#include "task_pool.h"
+
+// Rectangle of pixels [x0, x1) x [y0, y1) rendered as one unit of work.
+struct Tile {
+    int x0, y0, x1, y1;
+    int slot;                 // Index of the grid cell it came from, for cost tracking
+    double predicted_cost;    // Previous frame's cost of that cell, in ms
+};
+
+// Distributes the tiles of a frame over the shared TaskPool. Tiles follow a
+// Hilbert curve, and that sequence is cut into one contiguous, spatially
+// compact segment per thread with equal predicted cost. Each thread works its
+// own deque from the most to the least expensive tile; idle threads steal the
+// cheapest remaining tile from the busiest deque. The measured time of every
+// grid cell is kept for the next frame, and cells that were much more
+// expensive than average, or a large part of one thread's share, are split
+// into quadrants. Given a region, only the tiles touching it are rendered, and
+// the other cells keep their cost from the last frame that rendered them.
+class TileScheduler {
+public:
+    double split_threshold = 2.0;   // Split cells costing this many times the average
+    double share_fraction = 0.125;  // ... or this fraction of one thread's share
+    int min_split_size = 8;         // Never produce tiles smaller than this
+
+    template <typename RenderTile>
+    void run(int width, int height, int tile_size, RenderTile&& render_tile, const ScreenRegion* region = nullptr) {
+        TaskPool& pool = TaskPool::shared();
+        build_tiles(width, height, std::max(tile_size, 1), pool.concurrency());
+        if (region) {
+            tiles.erase(std::remove_if(tiles.begin(), tiles.end(), [&](const Tile& tile) {
+                return !region->overlaps(tile.x0, tile.y0, tile.x1, tile.y1, width, height);
+            }), tiles.end());
+        }
+        tile_ms.assign(tiles.size(), 0.0);
+        distribute(pool.concurrency());
+
+        // Workers busy elsewhere may join late, not at all, or leave early for
+        // interactive work; their queues are then emptied by stealing
+        const TaskLane lane = TaskPool::current_lane();
+        pool.run_workers(lane, [&](int thread) {
+            size_t tile_index;
+            while ((thread == 0 || !pool.should_yield(lane)) && next_tile(thread, tile_index)) {
+                auto start = std::chrono::steady_clock::now();
+                render_tile(tiles[tile_index]);
+                auto end = std::chrono::steady_clock::now();
+                tile_ms[tile_index] = std::chrono::duration<double, std::milli>(end - start).count();
+            }
+        });
+
+        // Cells that were split report the sum of their quadrants
+        for (const Tile& tile : tiles) {
+            cell_ms[tile.slot] = 0.0;
+        }
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            cell_ms[tiles[i].slot] += tile_ms[i];
+        }
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> tiles;
+        double remaining_cost = 0.0;
+    };
+
+    // Maps a distance along the Hilbert curve of an n x n grid (n a power of two)
+    // to grid coordinates.
+    static void hilbert_to_grid(int n, int d, int& x, int& y) {
+        x = y = 0;
+        for (int s = 1; s < n; s *= 2) {
+            int rx = 1 & (d / 2);
+            int ry = 1 & (d ^ rx);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+            x += s * rx;
+            y += s * ry;
+            d /= 4;
+        }
+    }
+
+    void build_tiles(int width, int height, int tile_size, int thread_count) {
+        const int cells_x = (width + tile_size - 1) / tile_size;
+        const int cells_y = (height + tile_size - 1) / tile_size;
+
+        // Cost history only carries over between frames with the same grid
+        bool has_history = cells_x == grid_x && cells_y == grid_y && grid_tile_size == tile_size;
+        if (!has_history) {
+            grid_x = cells_x;
+            grid_y = cells_y;
+            grid_tile_size = tile_size;
+            cell_ms.assign(static_cast<size_t>(cells_x) * cells_y, 0.0);
+        }
+
+        double total_ms = std::accumulate(cell_ms.begin(), cell_ms.end(), 0.0);
+        double average_ms = cell_ms.empty() ? 0.0 : total_ms / cell_ms.size();
+        double split_ms = std::min(split_threshold * average_ms, share_fraction * total_ms / std::max(thread_count, 1));
+
+        int n = 1;
+        while (n < std::max(cells_x, cells_y)) {
+            n *= 2;
+        }
+
+        tiles.clear();
+        for (int d = 0; d < n * n; ++d) {
+            int cx, cy;
+            hilbert_to_grid(n, d, cx, cy);
+            if (cx >= cells_x || cy >= cells_y) {
+                continue;
+            }
+
+            int slot = cy * cells_x + cx;
+            double cost = has_history ? std::max(cell_ms[slot], 1e-3) : 1.0;
+            Tile cell{ cx * tile_size, cy * tile_size,
+                std::min((cx + 1) * tile_size, width), std::min((cy + 1) * tile_size, height),
+                slot, cost };
+
+            bool split = has_history && average_ms > 0.0 && cost > split_ms &&
+                (cell.x1 - cell.x0) >= 2 * min_split_size && (cell.y1 - cell.y0) >= 2 * min_split_size;
+            if (!split) {
+                tiles.push_back(cell);
+                continue;
+            }
+
+            int mid_x = (cell.x0 + cell.x1) / 2;
+            int mid_y = (cell.y0 + cell.y1) / 2;
+            double quarter = cost * 0.25;
+            tiles.push_back({ cell.x0, cell.y0, mid_x, mid_y, slot, quarter });
+            tiles.push_back({ mid_x, cell.y0, cell.x1, mid_y, slot, quarter });
+            tiles.push_back({ cell.x0, mid_y, mid_x, cell.y1, slot, quarter });
+            tiles.push_back({ mid_x, mid_y, cell.x1, cell.y1, slot, quarter });
+        }
+    }
+
+    // Cuts the Hilbert-ordered tiles into equal-cost segments, one per thread,
+    // each ordered from the most to the least expensive tile.
+    void distribute(int thread_count) {
+        if (static_cast<int>(queues.size()) != thread_count) {
+            queues.clear();
+            for (int i = 0; i < thread_count; ++i) {
+                queues.push_back(std::make_unique<WorkQueue>());
+            }
+        }
+
+        double total_cost = 0.0;
+        for (const Tile& tile : tiles) {
+            total_cost += tile.predicted_cost;
+        }
+        const double share = total_cost / thread_count;
+
+        size_t begin = 0;
+        double accumulated = 0.0;
+        for (int thread = 0; thread < thread_count; ++thread) {
+            size_t end = begin;
+            double segment_cost = 0.0;
+            double target = share * (thread + 1);
+            while (end < tiles.size() && (thread == thread_count - 1 || accumulated + tiles[end].predicted_cost * 0.5 <= target)) {
+                accumulated += tiles[end].predicted_cost;
+                segment_cost += tiles[end].predicted_cost;
+                ++end;
+            }
+
+            WorkQueue& queue = *queues[thread];
+            queue.tiles.clear();
+            for (size_t i = begin; i < end; ++i) {
+                queue.tiles.push_back(i);
+            }
+            std::stable_sort(queue.tiles.begin(), queue.tiles.end(), [this](size_t a, size_t b) {
+                return tiles[a].predicted_cost > tiles[b].predicted_cost;
+            });
+            queue.remaining_cost = segment_cost;
+            begin = end;
+        }
+    }
+
+    bool next_tile(int thread, size_t& tile_index) {
+        {
+            WorkQueue& own = *queues[thread];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tiles.empty()) {
+                tile_index = own.tiles.front();
+                own.tiles.pop_front();
+                own.remaining_cost -= tiles[tile_index].predicted_cost;
+                return true;
+            }
+        }
+
+        // Steal from the queue with the most predicted work left
+        while (true) {
+            int victim = -1;
+            double most_remaining = 0.0;
+            for (int i = 0; i < static_cast<int>(queues.size()); ++i) {
+                if (i == thread) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(queues[i]->mutex);
+                if (!queues[i]->tiles.empty() && (victim < 0 || queues[i]->remaining_cost > most_remaining)) {
+                    victim = i;
+                    most_remaining = queues[i]->remaining_cost;
+                }
+            }
+            if (victim < 0) {
+                return false;
+            }
+
+            WorkQueue& queue = *queues[victim];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tiles.empty()) {
+                continue;   // Drained between the scan and the steal
+            }
+            tile_index = queue.tiles.back();
+            queue.tiles.pop_back();
+            queue.remaining_cost -= tiles[tile_index].predicted_cost;
+            return true;
+        }
+    }
+
+    std::vector<Tile> tiles;
+    std::vector<double> tile_ms;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    // Measured cost per grid cell of the last frame
+    std::vector<double> cell_ms;
+    int grid_x = 0;
+    int grid_y = 0;
+    int grid_tile_size = 0;
+};
+
+#endif // TILE_SCHEDULER_H
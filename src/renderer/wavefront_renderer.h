@@ -0,0 +1,362 @@
+#ifndef WAVEFRONT_RENDERER_H
+#define WAVEFRONT_RENDERER_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "gbuffer.h"
+#include "hit_cache.h"
+#include "render_gate.h"
+#include "scene.h"
+#include "screen_region.h"
+#include "task_pool.h"
+
+// Breadth-first alternative to Camera::render. Every camera ray of the frame
+// is generated up front and the paths advance one bounce at a time: the whole
+// queue is intersected, then shaded, which emits one shadow ray per lit light
+// and at most one reflection ray per path. Shadow and reflection queues are
+// sorted by direction octant and the Morton code of their origin before they
+// are traced, so neighbouring rays in a batch walk the same BVH nodes. Paths
+// end under the same rules as Camera::trace_path, and the image matches the
+// tile kernels up to rounding. Pixels outside 'region' are left as they were.
+// The hit records carry raw object and material pointers from one stage to the
+// next, so the frame holds 'gate' from the first intersection until the last
+// path ends, and a scene edit waits for the whole frame rather than a tile.
+class WavefrontRenderer {
+public:
+    void render(
+        const Camera& camera,
+        const SceneManager& manager,
+        FrameBuffer& target,
+        int samples_per_pixel = 1,
+        bool enable_antialias = false,
+        RenderGate* gate = nullptr,
+        GBuffer* guides = nullptr,
+        const ScreenRegion* region = nullptr,
+        HitCache* hits = nullptr
+    ) {
+        const int width = camera.get_image_width();
+        const int height = camera.get_image_height();
+        target.resize(width, height);
+        if (guides) {
+            guides->resize(width, height);
+        }
+        if (hits) {
+            hits->resize(width, height);
+        }
+        const int spp = enable_antialias ? std::max(samples_per_pixel, 1) : 1;
+
+        generate_camera_rays(camera, width, height, spp, region);
+        PathStats stats;
+        stats.paths = paths.size();
+        {
+            RenderGate::TileScope frame_scope(gate);
+            // An empty scene has no bounds, and no ray from a hit to key by them
+            bounds = manager.getObjects().empty() ? BoundingBox() : manager.bounding_box();
+            for (int depth = 1; !paths.empty(); ++depth) {
+                stats.rays += paths.size();
+                intersect(camera, manager, depth == 1 ? guides : nullptr, depth == 1 ? hits : nullptr);
+                shade(camera, manager, depth);
+                if (camera.shadowStatus()) {
+                    trace_shadows(manager);
+                }
+                sort_paths();
+            }
+        }
+
+        resolve(target, width, height, spp);
+        target.path_stats = stats;
+    }
+
+private:
+    // A path between bounces: the ray to trace next and the reflectance left.
+    struct PathState {
+        ray r;
+        double throughput;
+        uint32_t sample;     // Index into 'radiance'
+        bool camera_ray;     // First sample of its pixel, which fills the guides
+    };
+
+    // Light a hit receives unless something blocks 'r' before 'max_distance'.
+    struct ShadowQuery {
+        ray r;
+        double max_distance;
+        color contribution;
+        uint32_t sample;
+    };
+
+    static constexpr int chunk_size = 4096;
+
+    static int chunk_count(size_t items) {
+        return static_cast<int>((items + chunk_size - 1) / chunk_size);
+    }
+
+    // One path per sample of every pixel touching the region; the samples of a
+    // pixel are consecutive, and the first one uses the pixel center when there
+    // is no antialiasing.
+    void generate_camera_rays(const Camera& camera, int width, int height, int spp, const ScreenRegion* region) {
+        sample_pixels.clear();
+        std::vector<std::pair<int, int>> spans;
+        for (int y = 0; y < height; ++y) {
+            if (region) {
+                region->row_spans(y, width, height, 1, spans);
+            }
+            else {
+                spans.assign(1, { 0, width });
+            }
+            for (const auto& [first, last] : spans) {
+                for (int x = first; x < last; ++x) {
+                    sample_pixels.push_back(static_cast<uint32_t>(y) * width + x);
+                }
+            }
+        }
+
+        radiance.assign(sample_pixels.size() * spp, color(0, 0, 0));
+        paths.resize(radiance.size());
+        TaskPool::shared().parallel_for(0, chunk_count(sample_pixels.size()), [&](int chunk) {
+            const size_t end = std::min(sample_pixels.size(), static_cast<size_t>(chunk + 1) * chunk_size);
+            for (size_t i = static_cast<size_t>(chunk) * chunk_size; i < end; ++i) {
+                const int x = sample_pixels[i] % width;
+                const int y = sample_pixels[i] / width;
+                for (int s = 0; s < spp; ++s) {
+                    double offset_x = spp > 1 ? random_double(0.0, 1.0) : 0.5;
+                    double offset_y = spp > 1 ? random_double(0.0, 1.0) : 0.5;
+                    const uint32_t sample = static_cast<uint32_t>(i * spp + s);
+                    paths[sample] = { camera.primary_ray(x, y, offset_x, offset_y), 1.0, sample, s == 0 };
+                }
+            }
+        });
+        samples_per_pixel = spp;
+    }
+
+    void intersect(const Camera& camera, const SceneManager& manager, GBuffer* guides, HitCache* hits) {
+        hit_records.resize(paths.size());
+        hit_flags.assign(paths.size(), 0);
+        const int width = camera.get_image_width();
+        TaskPool::shared().parallel_for(0, chunk_count(paths.size()), [&](int chunk) {
+            const size_t end = std::min(paths.size(), static_cast<size_t>(chunk + 1) * chunk_size);
+            for (size_t i = static_cast<size_t>(chunk) * chunk_size; i < end; ++i) {
+                const PathState& path = paths[i];
+                hit_flags[i] = manager.hit(path.r, interval(0.001, infinity), hit_records[i]);
+                if (path.camera_ray && (guides || hits)) {
+                    const uint32_t pixel = sample_pixels[path.sample / samples_per_pixel];
+                    const hit_record* rec = hit_flags[i] ? &hit_records[i] : nullptr;
+                    if (guides) {
+                        Camera::store_guide(manager, *guides, pixel % width, pixel / width, rec);
+                    }
+                    if (hits) {
+                        hits->store(pixel % width, pixel / width, path.r, rec);
+                    }
+                }
+            }
+        });
+    }
+
+    // Adds the unshadowed light of every hit, queues its shadow rays and its
+    // reflection. Each chunk appends to its own queues, which are then joined
+    // in chunk order so the result does not depend on scheduling.
+    void shade(const Camera& camera, const SceneManager& manager, int depth) {
+        const bool shadows = camera.shadowStatus();
+        const double min_throughput = camera.get_min_throughput();
+        const bool russian_roulette = camera.russian_roulette_enabled();
+
+        const int chunks = chunk_count(paths.size());
+        chunk_paths.resize(chunks);
+        chunk_shadows.resize(chunks);
+        TaskPool::shared().parallel_for(0, chunks, [&](int chunk) {
+            std::vector<PathState>& next = chunk_paths[chunk];
+            std::vector<ShadowQuery>& queries = chunk_shadows[chunk];
+            next.clear();
+            queries.clear();
+
+            const size_t end = std::min(paths.size(), static_cast<size_t>(chunk + 1) * chunk_size);
+            for (size_t i = static_cast<size_t>(chunk) * chunk_size; i < end; ++i) {
+                const PathState& path = paths[i];
+                color& sample_color = radiance[path.sample];
+                if (!hit_flags[i]) {
+                    sample_color += path.throughput * camera.background_color(path.r);
+                    continue;
+                }
+
+                const hit_record& rec = hit_records[i];
+                const double reflection = rec.material->reflection;
+                const double weight = reflection > 0.0 ? path.throughput * (1.0 - reflection) : path.throughput;
+                const vec3 view_dir = unit_vector(-path.r.direction());
+                const color diffuse_color = rec.material->get_color(rec.u, rec.v);
+
+                sample_color += weight * Camera::ambient_light(diffuse_color);
+                camera.for_each_light(manager, rec, [&](const Light& light, const vec3& light_dir, double attenuation) {
+                    color contribution = weight * Camera::direct_light(rec, view_dir, diffuse_color, light, light_dir, attenuation);
+                    // Only lights the shadow cache cannot settle are queued
+                    ShadowCache::Visibility visibility = shadows ? camera.cached_visibility(light, rec) : ShadowCache::Visibility::Lit;
+                    if (visibility == ShadowCache::Visibility::Unknown) {
+                        queries.push_back({ Camera::shadow_ray(rec, light_dir), Camera::shadow_distance(light, rec.p),
+                            contribution, path.sample });
+                    }
+                    else if (visibility == ShadowCache::Visibility::Lit) {
+                        sample_color += contribution;
+                    }
+                });
+
+                if (reflection <= 0.0 || depth == Camera::max_depth) {
+                    continue;
+                }
+                double throughput = path.throughput * reflection;
+                if (throughput < min_throughput) {
+                    if (!russian_roulette || random_double(0.0, 1.0) >= throughput / min_throughput) {
+                        continue;
+                    }
+                    throughput = min_throughput;
+                }
+                vec3 reflected_dir = reflect(unit_vector(path.r.direction()), rec.normal);
+                next.push_back({ ray(rec.p + rec.normal * 1e-3, reflected_dir, ReflectionRays), throughput, path.sample, false });
+            }
+        });
+
+        paths.clear();
+        shadow_queries.clear();
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            paths.insert(paths.end(), chunk_paths[chunk].begin(), chunk_paths[chunk].end());
+            shadow_queries.insert(shadow_queries.end(), chunk_shadows[chunk].begin(), chunk_shadows[chunk].end());
+        }
+    }
+
+    // Traces the shadow queue in sorted order, then adds the light of the
+    // unblocked queries in queue order.
+    void trace_shadows(const SceneManager& manager) {
+        keys.resize(shadow_queries.size());
+        for (size_t i = 0; i < shadow_queries.size(); ++i) {
+            keys[i] = coherence_key(shadow_queries[i].r);
+        }
+        sort_order();
+
+        visible.assign(shadow_queries.size(), 0);
+        TaskPool::shared().parallel_for(0, chunk_count(order.size()), [&](int chunk) {
+            const size_t end = std::min(order.size(), static_cast<size_t>(chunk + 1) * chunk_size);
+            for (size_t k = static_cast<size_t>(chunk) * chunk_size; k < end; ++k) {
+                const ShadowQuery& query = shadow_queries[order[k]];
+                hit_record shadow_rec;
+                visible[order[k]] = !manager.hit(query.r, interval(0.001, query.max_distance), shadow_rec);
+            }
+        });
+
+        for (size_t i = 0; i < shadow_queries.size(); ++i) {
+            if (visible[i]) {
+                radiance[shadow_queries[i].sample] += shadow_queries[i].contribution;
+            }
+        }
+    }
+
+    void sort_paths() {
+        keys.resize(paths.size());
+        for (size_t i = 0; i < paths.size(); ++i) {
+            keys[i] = coherence_key(paths[i].r);
+        }
+        sort_order();
+
+        sorted_paths.resize(paths.size());
+        for (size_t k = 0; k < order.size(); ++k) {
+            sorted_paths[k] = paths[order[k]];
+        }
+        paths.swap(sorted_paths);
+    }
+
+    // Averages the samples of every pixel into 'target'.
+    void resolve(FrameBuffer& target, int width, int height, int spp) {
+        Uint32* pixels = target.data();
+        TaskPool::shared().parallel_for(0, chunk_count(sample_pixels.size()), [&](int chunk) {
+            const size_t end = std::min(sample_pixels.size(), static_cast<size_t>(chunk + 1) * chunk_size);
+            for (size_t i = static_cast<size_t>(chunk) * chunk_size; i < end; ++i) {
+                color pixel_color(0, 0, 0);
+                for (int s = 0; s < spp; ++s) {
+                    pixel_color += radiance[i * spp + s];
+                }
+                pixel_color *= (1.0 / spp);
+                const int x = sample_pixels[i] % width;
+                const int y = sample_pixels[i] / width;
+                write_color(pixels, x, height - 1 - y, width, height, pixel_color);
+            }
+        });
+    }
+
+    // Direction octant in the top 3 bits, then the Morton code of the origin
+    // within the scene bounds, 9 bits per axis.
+    uint32_t coherence_key(const ray& r) const {
+        const vec3& direction = r.direction();
+        uint32_t octant = (direction.x() < 0 ? 1u : 0u) | (direction.y() < 0 ? 2u : 0u) | (direction.z() < 0 ? 4u : 0u);
+
+        uint32_t cell[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            double extent = bounds.vmax[axis] - bounds.vmin[axis];
+            double t = (extent > 0.0 && std::isfinite(extent)) ? (r.origin()[axis] - bounds.vmin[axis]) / extent : 0.0;
+            cell[axis] = t > 0.0 ? static_cast<uint32_t>(std::min(t, 1.0) * 511.0) : 0u;
+        }
+        return (octant << 27) | (spread_bits(cell[0]) << 2) | (spread_bits(cell[1]) << 1) | spread_bits(cell[2]);
+    }
+
+    // Moves the low 9 bits of 'v' to every third bit.
+    static uint32_t spread_bits(uint32_t v) {
+        uint32_t result = 0;
+        for (int bit = 0; bit < 9; ++bit) {
+            result |= ((v >> bit) & 1u) << (3 * bit);
+        }
+        return result;
+    }
+
+    // Fills 'order' with the indices of 'keys' in stable ascending key order,
+    // by least-significant-digit radix sort over 10-bit digits.
+    void sort_order() {
+        const size_t count = keys.size();
+        order.resize(count);
+        scratch.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+
+        constexpr int digit_bits = 10;
+        constexpr uint32_t buckets = 1u << digit_bits;
+        std::array<size_t, buckets> offsets;
+        for (int shift = 0; shift < 30; shift += digit_bits) {
+            offsets.fill(0);
+            for (size_t i = 0; i < count; ++i) {
+                ++offsets[(keys[i] >> shift) & (buckets - 1)];
+            }
+            size_t start = 0;
+            for (size_t& offset : offsets) {
+                std::swap(offset, start);
+                start += offset;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t index = order[i];
+                scratch[offsets[(keys[index] >> shift) & (buckets - 1)]++] = index;
+            }
+            order.swap(scratch);
+        }
+    }
+
+    int samples_per_pixel = 1;
+    BoundingBox bounds;
+
+    std::vector<uint32_t> sample_pixels;   // Pixel index (y * width + x) of each listed pixel
+    std::vector<color> radiance;           // Per sample, spp consecutive samples per pixel
+    std::vector<PathState> paths;
+    std::vector<PathState> sorted_paths;
+    std::vector<hit_record> hit_records;
+    std::vector<uint8_t> hit_flags;
+    std::vector<ShadowQuery> shadow_queries;
+    std::vector<uint8_t> visible;
+    std::vector<std::vector<PathState>> chunk_paths;
+    std::vector<std::vector<ShadowQuery>> chunk_shadows;
+
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> scratch;
+};
+
+#endif // WAVEFRONT_RENDERER_H
@@ -2,9 +2,11 @@
 #include <SDL.h>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include <optional>
 #include "boundingbox.h"
 #include "camera.h"
+#include "framebuffer.h"
 #include "scene.h"
 
 // Project a 3D point (in world space) to 2D screen space.
@@ -41,12 +43,92 @@ std::optional<std::pair<int, int>> project(const point3& p, const Camera& camera
     return std::make_pair(screen_x, screen_y);
 }
 
-// Function to draw octree voxels
+// True if 'p' is not behind the surfaces recorded in 'aovs', a frame rendered
+// from 'camera' (possibly at another resolution).
+bool is_unoccluded(const point3& p, const Camera& camera, const FrameAOVs& aovs) {
+    double pixel_x, pixel_y;
+    if (!camera.project_to_pixel(p, pixel_x, pixel_y)) {
+        return false;
+    }
+    int x = static_cast<int>(std::floor(pixel_x * aovs.width / camera.get_image_width()));
+    int y = static_cast<int>(std::floor(pixel_y * aovs.height / camera.get_image_height()));
+    double surface = aovs.depth_at(x, y);
+    return camera.ray_distance(p) <= surface * 1.002 + 1e-3;
+}
+
+// Draws the segment from 'a' to 'b'. With 'aovs', it is sampled every couple
+// of screen pixels and only the runs in front of the rendered surfaces are drawn.
+void draw_depth_tested_line(SDL_Renderer* renderer, const point3& a, const point3& b,
+    const Camera& camera, const SDL_Rect& viewport, const FrameAOVs* aovs) {
+    auto start = project(a, camera, viewport);
+    auto end = project(b, camera, viewport);
+    if (!start || !end) {
+        return;
+    }
+    if (!aovs) {
+        SDL_RenderDrawLine(renderer, start->first, start->second, end->first, end->second);
+        return;
+    }
+
+    double length = std::hypot(end->first - start->first, end->second - start->second);
+    int steps = std::clamp(static_cast<int>(length / 2.0), 1, 512);
+    std::optional<std::pair<int, int>> run_start;
+    std::pair<int, int> run_end;
+    for (int i = 0; i <= steps; ++i) {
+        point3 p = a + (b - a) * (static_cast<double>(i) / steps);
+        auto screen = project(p, camera, viewport);
+        bool visible = screen && is_unoccluded(p, camera, *aovs);
+        if (visible) {
+            if (!run_start) {
+                run_start = screen;
+            }
+            run_end = *screen;
+        }
+        if (run_start && (!visible || i == steps)) {
+            SDL_RenderDrawLine(renderer, run_start->first, run_start->second, run_end.first, run_end.second);
+            run_start.reset();
+        }
+    }
+}
+
+// Copies the pixels of 'frame' into 'out' with the silhouette of object
+// 'object_id' drawn over them, using the frame's ObjectID buffer.
+void outline_object(const FrameBuffer& frame, size_t object_id, std::vector<Uint32>& out) {
+    const FrameAOVs& aovs = frame.aovs;
+    out = frame.pixels;
+    if (aovs.width != frame.width || aovs.height != frame.height) {
+        return;
+    }
+
+    const Uint32 outline_color = 0xFFFFA000;
+    for (int y = 0; y < aovs.height; ++y) {
+        for (int x = 0; x < aovs.width; ++x) {
+            if (aovs.object_at(x, y) != object_id) {
+                continue;
+            }
+            // Edge pixels of the object, on the inside
+            bool edge = aovs.object_at(x - 1, y) != object_id || aovs.object_at(x + 1, y) != object_id ||
+                aovs.object_at(x, y - 1) != object_id || aovs.object_at(x, y + 1) != object_id;
+            if (edge && x > 0 && y > 0 && x < aovs.width - 1 && y < aovs.height - 1) {
+                out[static_cast<size_t>(y) * frame.width + x] = outline_color;
+            }
+        }
+    }
+}
+
+// Function to draw octree voxels. When 'aovs' is given, edges hidden behind
+// the rendered surfaces are left out.
 void DrawOctreeWireframe(SDL_Renderer* renderer,
     const SceneManager& manager,
     const Camera& camera,
     const SDL_Rect& viewport,
-    const std::optional<BoundingBox>& highlighted_box) {
+    const std::optional<BoundingBox>& highlighted_box,
+    const FrameAOVs* aovs = nullptr) {
+
+    // Depths are only comparable with the world-space camera
+    if (aovs && (aovs->empty() || camera.CameraSpaceStatus())) {
+        aovs = nullptr;
+    }
 
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
 
@@ -61,10 +143,7 @@ void DrawOctreeWireframe(SDL_Renderer* renderer,
         SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
         std::vector<point3> corners = bb.getVertices();
         for (const auto& edge : edges) {
-            auto p1 = project(corners[edge[0]], camera, viewport);
-            auto p2 = project(corners[edge[1]], camera, viewport);
-            if (!p1 || !p2) continue;
-            SDL_RenderDrawLine(renderer, p1->first, p1->second, p2->first, p2->second);
+            draw_depth_tested_line(renderer, corners[edge[0]], corners[edge[1]], camera, viewport, aovs);
         }
         };
 
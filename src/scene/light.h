@@ -4,7 +4,10 @@
 #include "color.h"
 #include "vec3.h"
 #include "matrix4x4.h"
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
 
 class Light {
 public:
@@ -17,6 +20,26 @@ public:
     virtual vec3 get_light_direction(const vec3& point) const = 0;
     virtual double get_attenuation(const vec3& point) const = 0;
     virtual std::string get_type_name() const = 0;
+    virtual std::unique_ptr<Light> clone() const = 0;
+
+    // Distance beyond which this light adds less than 'threshold' to any
+    // surface with unit diffuse and specular coefficients; infinite for
+    // lights without falloff.
+    virtual double get_range(double threshold) const {
+        double brightest = std::max({ light_color.x(), light_color.y(), light_color.z() }) * intensity;
+        double min_falloff = threshold / (2.0 * brightest);
+        if (!(brightest > 0.0) || min_falloff >= 1.0) {
+            return 0.0;
+        }
+        // Solves falloff(range) == min_falloff
+        double c = 1.0 - 1.0 / min_falloff;
+        return (-0.1 + std::sqrt(0.01 - 0.04 * c)) / 0.02;
+    }
+
+    // Distance attenuation of point and spot lights.
+    static double falloff(double distance) {
+        return 1.0 / (1.0 + 0.1 * distance + 0.01 * distance * distance);
+    }
 
     virtual void transform(const Matrix4x4& matrix) {
         position = matrix.transform_point(position);
@@ -48,12 +71,16 @@ public:
 
     double get_attenuation(const vec3& point) const override {
         double distance = (get_position() - point).length();
-        return 1.0 / (1.0 + 0.1 * distance + 0.01 * distance * distance);
+        return falloff(distance);
     }
 
     std::string get_type_name() const override {
         return "Point Light";
     }
+
+    std::unique_ptr<Light> clone() const override {
+        return std::make_unique<PointLight>(*this);
+    }
 };
 
 class DirectionalLight : public Light {
@@ -70,10 +97,18 @@ public:
         return 1.0;
     }
 
+    double get_range(double) const override {
+        return std::numeric_limits<double>::infinity();
+    }
+
     std::string get_type_name() const override {
         return "Directional Light";
     }
 
+    std::unique_ptr<Light> clone() const override {
+        return std::make_unique<DirectionalLight>(*this);
+    }
+
     vec3 get_direction() const { return direction; }
     void set_direction(const vec3& dir) { direction = dir.normalized(); }
 
@@ -103,7 +138,7 @@ public:
         if (cos_angle < cos_outer_cutoff) return 0.0;
 
         double distance = (get_position() - point).length();
-        double attenuation = 1.0 / (1.0 + 0.1 * distance + 0.01 * distance * distance);
+        double attenuation = falloff(distance);
 
         if (cos_angle > cos_cutoff_angle) return attenuation;
 
@@ -116,9 +151,14 @@ public:
         return "Spot Light";
     }
 
+    std::unique_ptr<Light> clone() const override {
+        return std::make_unique<SpotLight>(*this);
+    }
+
     vec3 get_direction() const { return direction; }
     void set_direction(const vec3& dir) { direction = dir.normalized(); }
 
+    double get_cos_outer_cutoff() const { return cos_outer_cutoff; }
     double get_inner_cutoff() const { return acos(cos_cutoff_angle) * 180.0 / M_PI; }
     double get_outer_cutoff() const { return acos(cos_outer_cutoff) * 180.0 / M_PI; }
     void set_cutoff_angles(double inner, double outer) {
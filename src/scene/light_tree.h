@@ -0,0 +1,227 @@
+#ifndef LIGHT_TREE_H
+#define LIGHT_TREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "boundingbox.h"
+#include "light.h"
+#include "vec3.h"
+
+// Bounding volume hierarchy over the lights with falloff (point and spot
+// lights), so shading points only visit the lights that can reach them. Each
+// light reaches a sphere of Light::get_range(cutoff) around it, and a spot
+// light only its outer cone. Every node also sums the power of its lights,
+// which sample() uses to pick one light with probability proportional to its
+// estimated contribution when there are too many to evaluate them all.
+// Directional lights reach everything and are kept apart. The lights are
+// referenced, so the tree must be built again when they change.
+class LightTree {
+public:
+    // Contribution below which a light is left out, a fraction of one 8-bit
+    // step of a unit radiance.
+    static constexpr double default_cutoff = 1.0 / 1024.0;
+
+    void build(const std::vector<std::unique_ptr<Light>>& lights, double cutoff = default_cutoff) {
+        unbounded.clear();
+        bounded.clear();
+        nodes.clear();
+        for (const auto& light : lights) {
+            double range = light->get_range(cutoff);
+            if (!std::isfinite(range)) {
+                unbounded.push_back(light.get());
+            }
+            else if (range > 0.0) {
+                const SpotLight* spot = dynamic_cast<const SpotLight*>(light.get());
+                bounded.push_back({ light.get(), light->get_position(), range,
+                    spot ? spot->get_direction() : vec3(0, 0, 0), spot ? spot->get_cos_outer_cutoff() : -2.0,
+                    light->get_intensity() * std::max({ light->get_color().x(), light->get_color().y(), light->get_color().z() }) });
+            }
+        }
+        if (!bounded.empty()) {
+            std::vector<int> order(bounded.size());
+            std::iota(order.begin(), order.end(), 0);
+            build_node(order, 0, static_cast<int>(order.size()));
+        }
+    }
+
+    // Lights without a position or falloff, which reach every point.
+    const std::vector<const Light*>& unbounded_lights() const {
+        return unbounded;
+    }
+
+    size_t bounded_count() const {
+        return bounded.size();
+    }
+
+    // Calls visit(light) for every light that can reach 'p', directional
+    // lights first.
+    template <typename Visit>
+    void for_each_light(const point3& p, Visit&& visit) const {
+        for (const Light* light : unbounded) {
+            visit(*light);
+        }
+        if (nodes.empty()) {
+            return;
+        }
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!contains(node.reach, p)) {
+                continue;
+            }
+            if (node.light >= 0) {
+                if (reaches(bounded[node.light], p)) {
+                    visit(*bounded[node.light].light);
+                }
+                continue;
+            }
+            stack[top++] = node.right;
+            stack[top++] = node.left;
+        }
+    }
+
+    // Picks one light with falloff that can reach 'p', descending the tree
+    // with probability proportional to each child's power over its distance
+    // falloff. 'u' is uniform in [0, 1). Returns null when no such light
+    // reaches 'p'; otherwise 'pdf' is the probability it was picked.
+    const Light* sample(const point3& p, double u, double& pdf) const {
+        pdf = 1.0;
+        if (nodes.empty() || !contains(nodes[0].reach, p)) {
+            return nullptr;
+        }
+        int index = 0;
+        while (nodes[index].light < 0) {
+            const Node& node = nodes[index];
+            double left = importance(nodes[node.left], p);
+            double right = importance(nodes[node.right], p);
+            double total = left + right;
+            if (!(total > 0.0)) {
+                return nullptr;
+            }
+            double p_left = left / total;
+            if (u < p_left) {
+                index = node.left;
+                pdf *= p_left;
+                u = u / p_left;
+            }
+            else {
+                index = node.right;
+                pdf *= 1.0 - p_left;
+                u = (u - p_left) / (1.0 - p_left);
+            }
+            u = std::min(u, 1.0 - 1e-12);
+        }
+        const BoundedLight& chosen = bounded[nodes[index].light];
+        return reaches(chosen, p) ? chosen.light : nullptr;
+    }
+
+private:
+    struct BoundedLight {
+        const Light* light;
+        point3 position;
+        double range;
+        vec3 direction;      // Spot axis, zero for point lights
+        double cos_outer;    // Spot cone, below -1 for point lights
+        double power;        // Intensity times the brightest channel
+    };
+
+    struct Node {
+        BoundingBox reach;       // Union of the spheres the lights reach
+        BoundingBox positions;   // Bounds of the light positions
+        double power;
+        int left, right;         // Children, when 'light' is negative
+        int light;               // Index into 'bounded' for leaves
+    };
+
+    static bool contains(const BoundingBox& box, const point3& p) {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (p[axis] < box.vmin[axis] || p[axis] > box.vmax[axis]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool reaches(const BoundedLight& light, const point3& p) {
+        vec3 offset = p - light.position;
+        double distance_squared = offset.length_squared();
+        if (distance_squared > light.range * light.range) {
+            return false;
+        }
+        // Inside the outer cone: cos(angle) >= cos_outer
+        return light.cos_outer < -1.0 ||
+            dot(offset, light.direction) >= light.cos_outer * std::sqrt(distance_squared);
+    }
+
+    static double importance(const Node& node, const point3& p) {
+        if (!contains(node.reach, p)) {
+            return 0.0;
+        }
+        double distance_squared = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            double gap = std::max<double>({ node.positions.vmin[axis] - p[axis], 0.0, p[axis] - node.positions.vmax[axis] });
+            distance_squared += gap * gap;
+        }
+        return node.power * Light::falloff(std::sqrt(distance_squared));
+    }
+
+    // Builds the subtree of bounded[order[first..last)), splitting at the
+    // median position along the widest axis, and returns its index.
+    int build_node(std::vector<int>& order, int first, int last) {
+        const int index = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+
+        const double inf = std::numeric_limits<double>::infinity();
+        point3 min_position(inf, inf, inf);
+        point3 max_position(-inf, -inf, -inf);
+        point3 min_reach = min_position;
+        point3 max_reach = max_position;
+        double power = 0.0;
+        for (int i = first; i < last; ++i) {
+            const BoundedLight& light = bounded[order[i]];
+            const vec3 radius(light.range, light.range, light.range);
+            for (int axis = 0; axis < 3; ++axis) {
+                min_position[axis] = std::min(min_position[axis], light.position[axis]);
+                max_position[axis] = std::max(max_position[axis], light.position[axis]);
+                min_reach[axis] = std::min(min_reach[axis], light.position[axis] - radius[axis]);
+                max_reach[axis] = std::max(max_reach[axis], light.position[axis] + radius[axis]);
+            }
+            power += light.power;
+        }
+
+        Node node;
+        node.reach = BoundingBox(min_reach, max_reach);
+        node.positions = BoundingBox(min_position, max_position);
+        node.power = power;
+        node.left = node.right = -1;
+        node.light = -1;
+        if (last - first == 1) {
+            node.light = order[first];
+        }
+        else {
+            vec3 extent = max_position - min_position;
+            int axis = (extent.x() >= extent.y() && extent.x() >= extent.z()) ? 0 : (extent.y() >= extent.z() ? 1 : 2);
+            int middle = (first + last) / 2;
+            std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last, [&](int a, int b) {
+                return bounded[a].position[axis] < bounded[b].position[axis];
+            });
+            node.left = build_node(order, first, middle);
+            node.right = build_node(order, middle, last);
+        }
+        nodes[index] = node;
+        return index;
+    }
+
+    std::vector<const Light*> unbounded;
+    std::vector<BoundedLight> bounded;
+    std::vector<Node> nodes;   // Root first
+};
+
+#endif // LIGHT_TREE_H
@@ -1,6 +1,8 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <cstdint>
+#include <deque>
 #include <unordered_map>
 #include <memory>
 #include <optional>
@@ -15,11 +17,23 @@
 #include "octree.h"
 #include "bvh_node.h"
 #include "light.h"
+#include "light_tree.h"
 
 using std::shared_ptr;
 using std::make_shared;
 using ObjectID = size_t;
 
+// Edits made to a SceneManager after a given revision (see changes_since).
+struct SceneChanges {
+    bool everything = false;            // Lights or the whole scene changed
+    bool geometry = false;              // Objects were added, removed or moved
+    std::vector<BoundingBox> bounds;    // Old and new bounds of edited objects
+
+    bool empty() const {
+        return !everything && bounds.empty();
+    }
+};
+
 class SceneManager : public hittable {
 private:
 
@@ -28,26 +42,52 @@ private:
     // ------------------------------------------------------------------
     ObjectID next_id = 0;
     std::unordered_map<ObjectID, shared_ptr<hittable>> objects;
+    std::unordered_map<const hittable*, ObjectID> ids_by_object; // Reverse of 'objects'.
     std::vector<std::unique_ptr<Light>> lights;
+    LightTree light_tree;  // Rebuilt by every light edit
     std::unordered_set<ObjectID> used_ids; // Track all used IDs.
     shared_ptr<BVHNode> root_bvh = nullptr;  // Root of the BVH tree.
     std::unordered_map<ObjectID, Octree> octrees; // Maps each object ID to its corresponding octree.
 
+    // Recent edits, oldest first, for renderers that keep their previous frame.
+    struct ChangeEntry {
+        uint64_t revision;
+        bool everything;
+        bool geometry;
+        BoundingBox bounds;
+    };
+    static constexpr size_t max_logged_changes = 256;
+    std::deque<ChangeEntry> change_log;
+    uint64_t revision = 0;
+
     // ------------------------------------------------------------------
     //                        Private Helper Functions
     // ------------------------------------------------------------------
 
+    void log_change(bool everything, bool geometry, const BoundingBox& bounds = BoundingBox()) {
+        change_log.push_back({ ++revision, everything, geometry, bounds });
+        if (change_log.size() > max_logged_changes) {
+            change_log.pop_front();
+        }
+    }
+
+    void lights_changed() {
+        light_tree.build(lights);
+        log_change(true, false);
+    }
+
     bool defaultHitTraversal(const ray& r, interval ray_t, hit_record& rec) const {
-        hit_record temp_rec;
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;
         for (const auto& [id, object] : objects) {
-            if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            if (object->is_visible_to(r) && object->hit_closest(r, interval(ray_t.min, closest_so_far), rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
             }
         }
+        if (hit_anything) {
+            complete_pending_hit(r, rec);
+        }
         return hit_anything;
     }
 
@@ -74,6 +114,8 @@ public:
         // Register the ID as used and add the object.
         used_ids.insert(id);
         objects[id] = object;
+        ids_by_object[object.get()] = id;
+        log_change(false, true, object->bounding_box());
 
         // Update next_id to ensure no overlap with manually assigned IDs.
         if (manual_id && id >= next_id) {
@@ -90,6 +132,11 @@ public:
     void remove(ObjectID id) {
         auto it = objects.find(id);
         if (it != objects.end()) {
+            log_change(false, true, it->second->bounding_box());
+            auto reverse = ids_by_object.find(it->second.get());
+            if (reverse != ids_by_object.end() && reverse->second == id) {
+                ids_by_object.erase(reverse);
+            }
             objects.erase(it);          // Remove the object.
             used_ids.erase(id);           // Mark the ID as no longer used.
             // Remove the associated octree if it exists.
@@ -122,10 +169,15 @@ public:
 
     // Returns the ObjectID for a given object if it exists in the scene.
     std::optional<ObjectID> get_object_id(const std::shared_ptr<hittable>& object) const {
-        for (const auto& [id, obj] : objects) {
-            if (obj == object) {
-                return id;
-            }
+        return find_id(object.get());
+    }
+
+    // Returns the ObjectID of a top-level object, such as the hit_object of a
+    // hit_record from this scene. The pointer is only used as a key.
+    std::optional<ObjectID> find_id(const hittable* object) const {
+        auto it = ids_by_object.find(object);
+        if (it != ids_by_object.end()) {
+            return it->second;
         }
         return std::nullopt;
     }
@@ -142,13 +194,36 @@ public:
     // Clears all objects, lights, octrees, and resets the BVH
     void clear() {
         objects.clear();           // Remove all scene objects
+        ids_by_object.clear();
         used_ids.clear();          // Clear ID tracking
         octrees.clear();           // Clear any associated octrees
         lights.clear();            // Remove all lights
+        light_tree.build(lights);
         root_bvh = nullptr;        // Reset BVH tree
+        log_change(true, true);
     }
 
 
+    // Independent copy of the objects and lights for rendering while this scene
+    // keeps being edited. IDs are preserved and the BVH is built; octrees are
+    // not copied. Throws if an object does not support clone(), since sharing
+    // it would let edits race with the copy's renders.
+    std::unique_ptr<SceneManager> snapshot() const {
+        auto copy = std::make_unique<SceneManager>();
+        for (const auto& [id, object] : objects) {
+            shared_ptr<hittable> object_copy = object->clone();
+            object_copy->set_ray_visibility(object->get_ray_visibility());
+            copy->add(object_copy, id);
+        }
+        copy->next_id = next_id;
+        for (const auto& light : lights) {
+            copy->lights.push_back(light->clone());
+        }
+        copy->light_tree.build(copy->lights);
+        copy->buildBVH(false);
+        return copy;
+    }
+
     // Returns a list of (ObjectID, name) pairs for all objects in the scene.
     std::vector<std::pair<ObjectID, std::string>> list_object_names() const {
         std::vector<std::pair<ObjectID, std::string>> result;
@@ -173,7 +248,23 @@ public:
             }
         }
         transform_lights(transform);
-        // Invalidate BVH after transformation.
+        // Every object moved the same way, so the tree still fits; only its boxes change
+        if (root_bvh) {
+            root_bvh->refit();
+        }
+        log_change(true, true);
+    }
+
+    // Sets the RayVisibility bits of the rays that can hit an object, for
+    // example to keep a large ground plane from casting shadows. The BVH has
+    // to be built again.
+    void set_ray_visibility(ObjectID id, uint8_t mask) {
+        auto it = objects.find(id);
+        if (it == objects.end()) {
+            throw std::runtime_error("Invalid ObjectID: " + std::to_string(id));
+        }
+        it->second->set_ray_visibility(mask);
+        log_change(false, true, it->second->bounding_box());
         root_bvh = nullptr;
     }
 
@@ -181,13 +272,19 @@ public:
     // Updates its associated octree only if one exists.
     void transform_object(ObjectID id, const Matrix4x4& transform) {
         if (objects.find(id) != objects.end()) {
+            log_change(false, true, objects[id]->bounding_box());
             objects[id]->transform(transform);
+            log_change(false, true, objects[id]->bounding_box());
             if (octrees.find(id) != octrees.end()) {
                 BoundingBox bb = objects[id]->bounding_box();
                 Octree tree = Octree::FromObject(bb, *objects[id], 3);
                 octrees[id] = tree;
             }
-            root_bvh = nullptr;
+            // Objects with a placement only changed a matrix; the tree above
+            // them needs its boxes refitted, not a rebuild
+            if (root_bvh) {
+                root_bvh->refit();
+            }
         }
         else {
             throw std::runtime_error("Invalid ObjectID: " + std::to_string(id));
@@ -214,26 +311,31 @@ public:
      // Convenience methods for adding specific light types
     void add_point_light(const vec3& pos, double intensity, const color& col) {
         lights.push_back(std::make_unique<PointLight>(pos, intensity, col));
+        lights_changed();
     }
 
     void add_directional_light(const vec3& dir, double intensity, const color& col) {
         lights.push_back(std::make_unique<DirectionalLight>(dir, intensity, col));
+        lights_changed();
     }
 
     void add_spot_light(const vec3& pos, const vec3& dir, double intensity,
         const color& col, double cutoff, double outer_cutoff) {
         lights.push_back(std::make_unique<SpotLight>(pos, dir, intensity, col, cutoff, outer_cutoff));
+        lights_changed();
     }
 
     void transform_lights(const Matrix4x4& matrix) {
         for (auto& light : lights) {
             light->transform(matrix);
         }
+        lights_changed();
     }
 
     void remove_light(size_t index) {
         if (index < lights.size()) {
             lights.erase(lights.begin() + index);
+            lights_changed();
         }
     }
 
@@ -241,6 +343,75 @@ public:
         return lights;
     }
 
+    // Lights organized by where they reach, for shading.
+    const LightTree& get_light_tree() const {
+        return light_tree;
+    }
+
+    // ------------------------------------------------------------------
+    //                          Change Tracking
+    // ------------------------------------------------------------------
+
+    // Counter bumped by every edit made through this class.
+    uint64_t get_revision() const {
+        return revision;
+    }
+
+    // Edits made after 'since' (a value of get_revision()). Reports everything
+    // when the log no longer reaches back that far.
+    SceneChanges changes_since(uint64_t since) const {
+        SceneChanges changes;
+        if (since == revision) {
+            return changes;
+        }
+        if (change_log.empty() || change_log.front().revision > since + 1) {
+            changes.everything = true;
+            changes.geometry = true;
+            return changes;
+        }
+        for (const ChangeEntry& entry : change_log) {
+            if (entry.revision <= since) {
+                continue;
+            }
+            changes.everything |= entry.everything;
+            changes.geometry |= entry.geometry;
+            if (!entry.everything) {
+                changes.bounds.push_back(entry.bounds);
+            }
+        }
+        if (changes.everything) {
+            changes.bounds.clear();
+        }
+        return changes;
+    }
+
+    // Records edits made directly on an object's shape.
+    void mark_object_changed(ObjectID id) {
+        auto it = objects.find(id);
+        if (it != objects.end()) {
+            log_change(false, true, it->second->bounding_box());
+        }
+    }
+
+    // Records an in-place edit of an object's material, which leaves the
+    // geometry as it was.
+    void mark_material_changed(ObjectID id) {
+        auto it = objects.find(id);
+        if (it != objects.end()) {
+            log_change(false, false, it->second->bounding_box());
+        }
+    }
+
+    // Records light changes made through get_lights().
+    void mark_lights_changed() {
+        lights_changed();
+    }
+
+    // Records edits that may affect anything in the scene.
+    void mark_all_changed() {
+        log_change(true, true);
+    }
+
     // ------------------------------------------------------------------
     //                          Octree Management
     // ------------------------------------------------------------------
@@ -8,6 +8,7 @@
 #include "torus.h"
 #include "mesh.h"
 #include "asset_path.h"
+#include "task_pool.h"
 
 SceneBuilder::SceneBuilder()
     : black(0.0, 0.0, 0.0),
@@ -211,10 +212,23 @@ void SceneBuilder::buildSonicScene(SceneManager& world) {
     //Mesh Objects
 
     try {
-        ObjectID sonic = add_mesh_to_scene(AssetPath::Resolve("models/sonic.obj"), world, AssetPath::Resolve("models/sonic.mtl"));
-        ObjectID totemID = add_mesh_to_scene(AssetPath::Resolve("models/cenario/totem.obj"), world, AssetPath::Resolve("models/cenario/totem.mtl"));
-        ObjectID loopID = add_mesh_to_scene(AssetPath::Resolve("models/cenario/loop.obj"), world, AssetPath::Resolve("models/cenario/loop.mtl"));
-        ObjectID palmID = add_mesh_to_scene(AssetPath::Resolve("models/cenario/palm.obj"), world, AssetPath::Resolve("models/cenario/palm.mtl"));
+        // Parse the models in parallel, then add them in a fixed order so IDs stay stable
+        const char* models[4] = { "models/sonic", "models/cenario/totem", "models/cenario/loop", "models/cenario/palm" };
+        std::shared_ptr<Mesh> meshes[4];
+        TaskGroup loads(TaskLane::Background);
+        for (int i = 0; i < 4; i++) {
+            std::string obj_path = AssetPath::Resolve(std::string(models[i]) + ".obj");
+            std::string mtl_path = AssetPath::Resolve(std::string(models[i]) + ".mtl");
+            loads.run([&meshes, i, obj_path, mtl_path] {
+                meshes[i] = load_mesh(obj_path, mtl_path);
+            });
+        }
+        loads.wait();
+
+        ObjectID sonic = world.add(meshes[0]);
+        ObjectID totemID = world.add(meshes[1]);
+        ObjectID loopID = world.add(meshes[2]);
+        ObjectID palmID = world.add(meshes[3]);
 
         if (world.contains(loopID)) {
             Matrix4x4 loopTranslate = loopTranslate.translation(vec3(0, 1, -6));